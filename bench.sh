@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+set -e
+
+# Сравнение бэкендов ввода-вывода на одной и той же эхо-нагрузке.
+# Аргументы передаются в bin/bench, например: ./bench.sh --connections 200 --duration 5
+BENCH_ARGS=("$@")
+if [ ${#BENCH_ARGS[@]} -eq 0 ]; then
+    BENCH_ARGS=(--connections 100 --pipeline 8 --mix echo=1 --duration 5 --warmup 1)
+fi
+
+make all bench
+
+STATUS=0
+for BACKEND in epoll uring; do
+    ./bin/cpp-network-server --io-backend "$BACKEND" --log-level warn &
+    SERVER_PID=$!
+    sleep 1
+
+    echo "== $BACKEND =="
+    ./bin/bench "${BENCH_ARGS[@]}" || STATUS=$?
+
+    kill "$SERVER_PID" || true
+    wait "$SERVER_PID" 2>/dev/null || true
+done
+
+exit "$STATUS"
@@ -0,0 +1,146 @@
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <sys/uio.h>
+#include "buffer_pool.hpp"
+
+// Persistent per-connection receive buffer.
+//
+// Bytes are received straight into the free tail of a pooled chunk and complete lines are
+// handed out as string_views into it, so nothing is copied or erased per line. Lines can
+// also be queued for sending by reference to the chunk (see OutputBuffer::appendShared);
+// bytes of a chunk someone else still references are never overwritten, the partial line
+// moves to a fresh chunk instead. Only an incomplete trailing line is ever moved, and only
+// when the tail runs out of space. The scan position is remembered, so a long partial line
+// is searched for '\n' once.
+class InputBuffer
+{
+public:
+    InputBuffer() = default;
+
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    // Makes room for at least one more recv(). Returns false if the pending partial line
+    // already exceeds `limit` bytes, i.e. the peer exceeded the maximum line length.
+    bool prepareWrite(BufferPool& pool, size_t limit);
+
+    // Valid after prepareWrite(); never more than a line of `limit` bytes can still use.
+    char* writePtr() { return _chunk.data() + _tail; }
+    size_t writable() const { return _end - _tail; }
+    void commit(size_t n) { _tail += n; }
+
+    // Extracts the next complete line without its terminating '\n'. The view stays
+    // valid until the next prepareWrite() or release().
+    bool nextLine(std::string_view& line);
+    // Puts back the line the last nextLine() returned, so that it is returned again.
+    void unget(std::string_view line)
+    {
+        _head = static_cast<size_t>(line.data() - _chunk.data());
+        _scan = _head + line.size();
+    }
+
+    // Unconsumed bytes, for framings that know their lengths and need no '\n' scan.
+    // Valid like the views from nextLine().
+    std::string_view unread() const
+    {
+        return _tail > _head ? std::string_view(_chunk.data() + _head, _tail - _head) : std::string_view();
+    }
+    void consume(size_t n)
+    {
+        _head += n;
+        _scan = std::max(_scan, _head);
+    }
+
+    // The chunk holding the lines returned by nextLine().
+    const ChunkRef& chunk() const { return _chunk; }
+
+    size_t pending() const { return _tail - _head; }
+
+    // Drops the chunk; the next prepareWrite() takes a new one from the pool.
+    void release();
+
+private:
+    void compact();
+
+private:
+    ChunkRef _chunk;
+    size_t _head = 0;       // first unconsumed byte
+    size_t _scan = 0;       // bytes in [_head, _scan) are known to contain no '\n'
+    size_t _tail = 0;       // end of received data
+    size_t _end = 0;        // end of the space handed out by prepareWrite()
+
+    static constexpr size_t MIN_READ = 512;
+};
+
+// Per-connection queue of bytes accepted for sending but not yet taken by the kernel.
+//
+// The queue is a list of segments: slices of pooled chunks queued by reference (echoed
+// input) and bytes the server formatted itself, owned by the queue. Slices that continue
+// each other merge, so a burst of pipelined echoes leaves as a single iovec. The storage of
+// drained owned segments is kept for the next one, so a connection that keeps up never
+// reallocates. The segment list itself is only allocated by the first append, so an idle
+// connection slot holds no heap memory.
+class OutputBuffer
+{
+public:
+    void append(std::string_view data) { appendTarget().append(data); }
+    void append(char c) { appendTarget().push_back(c); }
+
+    // Queues `length` bytes at `data`, which lie inside `chunk`, without copying them.
+    void appendShared(const ChunkRef& chunk, const char* data, size_t length);
+
+    // Owned bytes at the end of the queue, for writers that format in place. Only append to it.
+    std::string& appendTarget();
+
+    size_t size() const { return _size + openBytes() - _head; }
+    bool empty() const { return size() == 0; }
+
+    // Describes up to `max` segments from the front of the queue in `iov`; returns how many.
+    // With `split` > 0, a shared slice of at least `split` bytes is never batched with other
+    // segments: it is either returned alone or ends the batch before it.
+    size_t gather(iovec* iov, size_t max, size_t split = 0) const;
+    // The chunk of the first segment, if that segment is a shared slice.
+    const ChunkRef* frontChunk() const;
+
+    void consume(size_t n);
+    void release();
+
+    // Moves everything queued into `dst`, which must be empty, without copying: the bytes
+    // stay where they are. For senders that hand the kernel pointers into the queue and need
+    // them to stay valid while more output is queued.
+    void takeInto(OutputBuffer& dst);
+
+private:
+    struct Segment
+    {
+        ChunkRef chunk;             // set for a shared slice
+        const char* data = nullptr;
+        size_t length = 0;
+        std::string bytes;          // owned bytes otherwise
+
+        const char* begin() const { return chunk ? data : bytes.data(); }
+        size_t size() const { return chunk ? length : bytes.size(); }
+    };
+
+    // The last segment keeps growing while it holds owned bytes, so it is counted apart.
+    size_t openBytes() const
+    {
+        return _segments && !_segments->empty() && !_segments->back().chunk ? _segments->back().bytes.size() : 0;
+    }
+    std::deque<Segment>& segments();
+    void popFront();
+
+private:
+    std::unique_ptr<std::deque<Segment>> _segments;    // null until the first append
+    size_t _size = 0;           // bytes in all segments but an open owned one at the back
+    size_t _head = 0;           // bytes of the first segment already sent
+    std::string _spare;         // storage of the last drained owned segment
+};
+#endif // BUFFER_HPP
@@ -0,0 +1,91 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class BufferPool;
+
+// Header of a pooled byte chunk; the bytes follow it in memory.
+struct Chunk
+{
+    BufferPool* pool;
+    Chunk* next_free;
+    size_t capacity;
+    uint32_t refs;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+// Counted reference to a Chunk. The chunk goes back to its pool when the last
+// reference is dropped. Counts are not atomic: a chunk never leaves its reactor's thread.
+class ChunkRef
+{
+public:
+    ChunkRef() = default;
+    explicit ChunkRef(Chunk* chunk) : _chunk{ chunk } { if (_chunk) ++_chunk->refs; }
+    ChunkRef(const ChunkRef& other) : ChunkRef(other._chunk) {}
+    ChunkRef(ChunkRef&& other) noexcept : _chunk{ other._chunk } { other._chunk = nullptr; }
+    ~ChunkRef() { reset(); }
+
+    ChunkRef& operator=(const ChunkRef& other);
+    ChunkRef& operator=(ChunkRef&& other) noexcept;
+
+    void reset();
+
+    Chunk* get() const { return _chunk; }
+    char* data() const { return _chunk->data(); }
+    size_t capacity() const { return _chunk ? _chunk->capacity : 0; }
+    // Someone else still reads the bytes, so they must not be overwritten.
+    bool shared() const { return _chunk && _chunk->refs > 1; }
+
+    explicit operator bool() const { return _chunk != nullptr; }
+
+private:
+    Chunk* _chunk = nullptr;
+};
+
+// Per-reactor arena of reference-counted byte chunks.
+//
+// Client input is received into chunks, so an echoed line can be queued for sending as a
+// slice of the chunk it arrived in instead of being copied. Standard-size chunks are carved
+// from slabs and recycled through a free list; larger ones, needed only for lines longer
+// than a chunk, are allocated individually and freed when released. Only the owning
+// reactor's thread may touch the pool or its chunks, and the pool must outlive them.
+class BufferPool
+{
+public:
+    explicit BufferPool(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // A chunk of at least `min_capacity` bytes: a pooled one when it fits.
+    ChunkRef acquire(size_t min_capacity);
+
+    size_t chunkSize() const { return _chunk_size; }
+    size_t allocated() const { return _allocated; }   // standard chunks carved so far
+    size_t available() const { return _available; }   // of which on the free list
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 16384;
+
+private:
+    friend class ChunkRef;
+    void recycle(Chunk* chunk);
+    void grow();
+
+private:
+    size_t _chunk_size;
+    size_t _stride;             // header + bytes, rounded up to a cache line
+    std::vector<std::unique_ptr<char[]>> _slabs;
+    Chunk* _free = nullptr;
+    size_t _allocated = 0;
+    size_t _available = 0;
+
+    static constexpr size_t SLAB_CHUNKS = 64;
+};
+
+#endif // BUFFER_POOL_HPP
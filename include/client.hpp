@@ -2,21 +2,64 @@
 #define CLIENT_HPP
 
 #include <string>
+#include <vector>
 #include <chrono>
 #include <cstdint>
+#include <sys/socket.h>
+#include "buffer.hpp"
+#include "timer_wheel.hpp"
+#include "endpoint.hpp"
+#include "token_bucket.hpp"
+#include "pubsub.hpp"
 
-struct ClientInfo 
+// One TCP connection. Records live in pooled slots of the reactor's ConnectionTable and
+// are reused for later connections; `generation` tells the uses apart.
+struct ClientInfo
 {
-    std::string address;
-    uint16_t port;
+    int fd = -1;
+    uint32_t slot = 0;          // index in the ConnectionTable
+    uint32_t generation = 0;
+    bool active = false;
+    bool want_write = false;    // a write is outstanding: EPOLLOUT armed or a send in flight
+    bool read_paused = false;   // output reached the high-water mark, reading stopped
+    bool write_failed = false;  // send() failed hard, the connection must be dropped
+    bool batching = false;      // replies are collected until the current input pass ends
+    bool job_pending = false;   // a command runs on the worker pool; later input waits for it
+    bool lingering = false;     // drained on shutdown: FIN sent, input discarded until EOF
+    bool ktls = false;          // TLS records are encrypted and decrypted by the kernel
+
+    // Chosen by the first byte received: text lines, or binary frames (see frame.hpp).
+    enum class Framing : uint8_t { Unknown, Lines, Frames };
+    Framing framing = Framing::Unknown;
+
+    sockaddr_storage address;
+    socklen_t address_len = 0;
     std::chrono::system_clock::time_point connect_time;
-    uint64_t bytes_received;
-    uint64_t bytes_sent;
-    
-    ClientInfo(const std::string& addr, uint16_t p) 
-        : address(addr), port(p), 
-          connect_time(std::chrono::system_clock::now()),
-          bytes_received(0), bytes_sent(0) {}
+    uint64_t bytes_received = 0;
+    uint64_t bytes_sent = 0;
+
+    TimerId deadline_timer = 0;
+    uint64_t deadline_ms = 0;       // when deadline_timer fires, UINT64_MAX if not armed
+    uint64_t last_activity_ms = 0;  // last byte received or sent
+    uint64_t read_started_ms = 0;   // an incomplete line has been buffered since, 0 if none
+    uint64_t write_started_ms = 0;  // output has been queued without progress since, 0 if none
+
+    TokenBucket rate_bucket;        // --client-rate
+    TimerId rate_timer = 0;         // reading resumes when tokens are back (--rate-action delay)
+
+    InputBuffer input;
+    OutputBuffer output;
+
+    std::vector<Subscription> subscriptions;    // pub/sub channels, see ChannelTable
+
+    void open(int client_fd, const sockaddr_storage& addr, socklen_t addr_len,
+              std::chrono::system_clock::time_point now);
+    void close();
+
+    // Backend tag for this connection: generation in bits 32..55, slot in the low half.
+    // The top byte stays free for the backend's own use.
+    static constexpr uint32_t GENERATION_MASK = (1u << 24) - 1;
+    uint64_t token() const { return (static_cast<uint64_t>(generation) << 32) | slot; }
 };
 
-#endif //CLIENT_HPP
\ No newline at end of file
+#endif //CLIENT_HPP
@@ -0,0 +1,161 @@
+#ifndef COMMAND_REGISTRY_HPP
+#define COMMAND_REGISTRY_HPP
+
+#include <array>
+#include <charconv>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <cstdint>
+#include <sys/socket.h>
+
+class Reactor;
+struct ClientInfo;
+
+// Appends a reply in place to whatever the transport has queued for sending, so handlers
+// format straight into the connection's output instead of building temporary strings.
+// The transport adds the terminating newline.
+class ReplyWriter
+{
+public:
+    explicit ReplyWriter(std::string& out)
+        :   _out{ out }, _start{ out.size() }
+    {
+    }
+
+    ReplyWriter& operator<<(std::string_view text)
+    {
+        _out.append(text);
+        return *this;
+    }
+
+    ReplyWriter& operator<<(const char* text) { return *this << std::string_view(text); }
+
+    ReplyWriter& operator<<(char c)
+    {
+        _out.push_back(c);
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    ReplyWriter& operator<<(T value)
+    {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        _out.append(digits, static_cast<size_t>(result.ptr - digits));
+        return *this;
+    }
+
+    size_t written() const { return _out.size() - _start; }
+
+private:
+    std::string& _out;
+    size_t _start;
+};
+
+// Where a command came from. Exactly one of `client` (TCP) and `udp_peer` is set.
+struct CommandContext
+{
+    Reactor& reactor;
+    ClientInfo* client;
+    const sockaddr_storage* udp_peer;
+};
+
+// Whitespace-separated arguments following the command name, as views into the line.
+class CommandArgs
+{
+public:
+    static constexpr size_t MAX_ARGS = 8;
+
+    size_t size() const { return _count; }
+    std::string_view operator[](size_t i) const { return _args[i]; }
+
+    // Parses argument `i` as a signed decimal integer; false if it isn't one.
+    bool toInt(size_t i, int64_t& value) const;
+
+private:
+    friend class CommandRegistry;
+
+    std::array<std::string_view, MAX_ARGS> _args;
+    size_t _count = 0;
+};
+
+// Declares how a command's arguments are parsed before its handler runs.
+struct CommandSpec
+{
+    size_t min_args = 0;
+    size_t max_args = 0;            // at most CommandArgs::MAX_ARGS
+    bool rest = false;              // the last argument takes the remainder of the line
+    std::string_view usage;         // shown when the argument count is wrong
+    // Calls per second over all clients and reactors (0: unlimited); see --command-rate.
+    uint32_t rate_limit = 0;
+};
+
+using CommandHandler = std::function<void(CommandContext& context, const CommandArgs& args, ReplyWriter& reply)>;
+// Handler of a slow command, run on the worker pool instead of the reactor thread. It gets
+// no CommandContext: nothing of the connection or the reactor is safe to use from there.
+using OffloadedHandler = std::function<void(const CommandArgs& args, ReplyWriter& reply)>;
+
+// Table of slash commands.
+//
+// Names are looked up through a perfect hash: whenever a command is added, the table is
+// rebuilt with a seed and size under which no two names collide, so resolving a command
+// is one hash of the name and one comparison, with no allocation. Commands must be
+// registered before the reactors start; afterwards the table is only read.
+class CommandRegistry
+{
+public:
+    // Registers `name` (including the leading '/'). Returns false if it is already taken.
+    bool add(std::string_view name, const CommandSpec& spec, CommandHandler handler);
+    // Registers a command for the worker pool; with no pool it runs inline like the others.
+    bool addOffloaded(std::string_view name, const CommandSpec& spec, OffloadedHandler handler);
+
+    // Runs one command line. Unknown commands and bad argument counts are answered here.
+    // Returns the command's registration index, or -1 if no handler ran.
+    int execute(CommandContext& context, std::string_view line, ReplyWriter& reply) const;
+    // Runs the command registered `index`-th with the argument text `args`, e.g. for a
+    // binary frame that names its command by opcode.
+    int execute(CommandContext& context, size_t index, std::string_view args, ReplyWriter& reply) const;
+    // Runs the offloaded command registered `index`-th, on a worker thread.
+    int executeOffloaded(size_t index, std::string_view args, ReplyWriter& reply) const;
+
+    // Index of the command `line` starts with, or -1; `args` gets the rest of the line.
+    int lookup(std::string_view line, std::string_view& args) const;
+    bool offloaded(size_t index) const { return static_cast<bool>(_entries[index].offloaded); }
+    uint32_t rateLimit(size_t index) const { return _entries[index].spec.rate_limit; }
+    // Overrides the rate limit of command `name`; false if there is no such command.
+    bool setRateLimit(std::string_view name, uint32_t rate);
+
+    bool contains(std::string_view name) const { return find(name) != nullptr; }
+    size_t size() const { return _entries.size(); }
+    // Name of the command registered `index`-th.
+    std::string_view name(size_t index) const { return _entries[index].name; }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        CommandSpec spec;
+        std::string usage;          // owned copy of spec.usage
+        CommandHandler handler;
+        OffloadedHandler offloaded;     // set instead of `handler` for offloaded commands
+    };
+
+    bool insert(std::string_view name, const CommandSpec& spec, Entry entry);
+    const Entry* find(std::string_view name) const;
+    // `context` is nullptr on a worker thread, where only offloaded handlers run.
+    int run(const Entry& entry, CommandContext* context, std::string_view args, ReplyWriter& reply) const;
+    void rebuild();
+    static uint64_t hash(std::string_view name, uint64_t seed);
+    static bool parseArgs(std::string_view text, const CommandSpec& spec, CommandArgs& args);
+
+private:
+    std::vector<Entry> _entries;
+    std::vector<int32_t> _slots;    // index into _entries, or -1
+    uint64_t _seed = 0;
+    uint64_t _mask = 0;
+};
+
+#endif // COMMAND_REGISTRY_HPP
@@ -0,0 +1,36 @@
+#ifndef COMPLETION_QUEUE_HPP
+#define COMPLETION_QUEUE_HPP
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <sys/socket.h>
+#include "frame.hpp"
+#include "mpsc_queue.hpp"
+
+// A command run on a worker thread. It carries copies of everything the worker needs,
+// since the input it came from may be reused meanwhile, and travels back to its reactor
+// with the reply.
+struct OffloadedCommand
+{
+    OffloadedCommand* next = nullptr;   // link in a CompletionQueue
+
+    uint64_t token = 0;                 // client connection; 0 for a UDP peer
+    sockaddr_storage udp_addr{};
+    socklen_t udp_addr_len = 0;
+    int udp_socket = -1;                // the reply leaves from the socket the request came in on
+    bool framed = false;                // reply as a binary frame with `frame`'s id and opcode
+    FrameHeader frame;
+
+    size_t index = 0;                   // registration index of the command
+    std::string args;
+    std::chrono::steady_clock::time_point start;
+
+    std::string reply;                  // filled in by the worker
+    int result = -1;                    // index, or -1 if no handler ran
+};
+
+// Finished commands on their way back to the reactor that submitted them.
+using CompletionQueue = MpscQueue<OffloadedCommand>;
+
+#endif // COMPLETION_QUEUE_HPP
@@ -0,0 +1,50 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "endpoint.hpp"
+
+struct ServerConfig
+{
+    int tcp_port = 8080;
+    int udp_port = 8081;
+    std::vector<Endpoint> tcp_listen; // TCP bind addresses (empty: [::]:tcp_port, dual-stack)
+    std::vector<Endpoint> udp_listen; // UDP bind addresses (empty: [::]:udp_port, dual-stack)
+    int threads = 1;                // number of independent reactors (event loops)
+    int worker_threads = 2;         // pool for offloaded commands (0: run them inline)
+    int max_line_length = 65536;    // longest accepted TCP line, in bytes
+    int max_connections = 0;        // open TCP connections, split evenly over reactors (0: unlimited)
+    int accept_budget = 64;         // connections accepted per listener and loop iteration
+    int defer_accept_seconds = 0;   // TCP_DEFER_ACCEPT: wake for a connection only once data arrives
+    int write_high_water = 1 << 20; // queued output at which reading from a client pauses
+    int udp_batch = 32;             // datagrams per recvmmsg()/sendmmsg()
+    int udp_peer_capacity = 16384;  // UDP peers tracked per reactor
+    int udp_peer_idle_seconds = 60; // UDP peers silent for longer are expired
+    int idle_timeout_seconds = 300; // close TCP clients without traffic for this long (0: never)
+    int read_timeout_seconds = 30;  // limit for completing a started line (0: none)
+    int write_timeout_seconds = 30; // limit for queued output to make progress (0: none)
+    int drain_timeout_seconds = 5;  // on shutdown, time for queued replies to go out
+    int client_rate = 0;            // messages per second per TCP connection (0: unlimited)
+    int client_burst = 0;           // messages at once above that rate (0: one second's worth)
+    int udp_rate = 0;               // messages per second per UDP peer (0: unlimited)
+    int udp_burst = 0;
+    std::vector<std::pair<std::string, int>> command_rates; // calls per second over all clients
+    std::string rate_action = "delay"; // drop, delay or reject
+    std::string slow_subscriber = "drop"; // drop or disconnect a subscriber at write_high_water
+    std::string log_level = "info"; // debug, info, warn or error
+    std::string log_file;           // empty: log to stdout
+    int log_rate_limit = 100;       // records per second per log statement (0: unlimited)
+    std::string io_backend = "epoll"; // epoll or uring
+    int zerocopy_threshold = 0;     // echoes of at least this many bytes use MSG_ZEROCOPY (0: off)
+    bool low_latency = false;       // reactors poll without sleeping before they block
+    int busy_poll_usec = 50;        // --low-latency: polling budget per wait, also SO_BUSY_POLL
+    std::vector<int> cpus;          // reactor i runs on cpus[i % size] (empty: unpinned)
+    int metrics_port = 0;           // HTTP port for Prometheus /metrics on 127.0.0.1 (0: off)
+    int tls_port = 0;               // TLS listener offloaded to kernel TLS (0: off; needs make TLS=1)
+    std::string tls_cert;           // PEM certificate chain for tls_port
+    std::string tls_key;            // PEM private key for tls_port
+};
+
+#endif // CONFIG_HPP
@@ -0,0 +1,61 @@
+#ifndef CONNECTION_TABLE_HPP
+#define CONNECTION_TABLE_HPP
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include "client.hpp"
+
+// Per-reactor table of ClientInfo slots, indexed by a dense slot number of its own.
+//
+// Fds are process-wide, so a reactor only ever sees a scattered share of them; slots come
+// from a free list instead, and a reactor's table stays as large as its own peak of open
+// connections. Released slots are reused most recent first. Slots live in fixed pages, so
+// a record never moves once created and pages are reused across connections. Each reuse
+// bumps the slot generation, which lets resolve() reject stale backend tokens.
+class ConnectionTable
+{
+public:
+    ClientInfo& acquire(int fd, const sockaddr_storage& addr, socklen_t addr_len,
+                        std::chrono::system_clock::time_point now);
+    void release(ClientInfo& client);
+
+    // Maps a backend token back to its connection, or nullptr if that connection is gone.
+    ClientInfo* resolve(uint64_t token)
+    {
+        uint32_t slot = static_cast<uint32_t>(token);
+        if (slot >= _slots)
+            return nullptr;
+
+        ClientInfo& client = _pages[slot >> PAGE_SHIFT][slot & PAGE_MASK];
+        return client.active && client.generation == static_cast<uint32_t>(token >> 32) ? &client : nullptr;
+    }
+
+    size_t size() const { return _size; }
+    // Slots handed out so far, open or free; ClientInfo::slot is always below it.
+    size_t capacity() const { return _slots; }
+
+    template <typename Fn>
+    void forEach(Fn&& fn)
+    {
+        for (size_t slot = 0; slot < _slots; ++slot)
+        {
+            ClientInfo& client = _pages[slot >> PAGE_SHIFT][slot & PAGE_MASK];
+            if (client.active)
+                fn(client);
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<ClientInfo[]>> _pages;
+    std::vector<uint32_t> _free;    // released slots
+    uint32_t _slots = 0;            // slots ever handed out
+    size_t _size = 0;
+
+    static constexpr size_t PAGE_SHIFT = 8;
+    static constexpr size_t PAGE_SIZE = size_t{ 1 } << PAGE_SHIFT;
+    static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+};
+
+#endif // CONNECTION_TABLE_HPP
@@ -0,0 +1,30 @@
+#ifndef CPU_AFFINITY_HPP
+#define CPU_AFFINITY_HPP
+
+#include <string_view>
+#include <vector>
+
+// Parses a CPU list such as "0-3,8,10-11" and appends the CPUs to `cpus`.
+bool parseCpuList(std::string_view text, std::vector<int>& cpus);
+
+// Restricts the calling thread to `cpu`. False if the kernel refuses, with errno set.
+bool pinThread(int cpu);
+// NUMA node of `cpu`, from sysfs; -1 if it cannot be told.
+int cpuNode(int cpu);
+
+// While alive, memory the calling thread faults in comes from NUMA node `node` if it has
+// any free (MPOL_PREFERRED). A negative node leaves the policy alone.
+class PreferredNode
+{
+public:
+    explicit PreferredNode(int node);
+    ~PreferredNode();
+
+    PreferredNode(const PreferredNode&) = delete;
+    PreferredNode& operator=(const PreferredNode&) = delete;
+
+private:
+    bool _set = false;
+};
+
+#endif // CPU_AFFINITY_HPP
@@ -0,0 +1,35 @@
+#ifndef ENDPOINT_HPP
+#define ENDPOINT_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/socket.h>
+
+// An IPv4 or IPv6 socket address, kept in binary form.
+struct Endpoint
+{
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+};
+
+// Parses "ADDR:PORT" with a numeric address: "10.0.0.5:9090", "[::1]:8080". "*:PORT" and
+// "[::]:PORT" both mean every address, IPv6 and IPv4 alike.
+bool parseEndpoint(std::string_view text, Endpoint& endpoint);
+// Parses a comma-separated list of endpoints and appends them to `endpoints`.
+bool parseEndpointList(std::string_view text, std::vector<Endpoint>& endpoints);
+
+// [::]:port, which also accepts IPv4 through mapped addresses.
+Endpoint anyEndpoint(int port);
+// The configured endpoints, or anyEndpoint(default_port) if there are none.
+std::vector<Endpoint> listenEndpoints(const std::vector<Endpoint>& configured, int default_port);
+
+// Opens a socket for `endpoint`. IPv6 sockets are dual-stack; on a host without IPv6 the
+// wildcard falls back to 0.0.0.0, and `endpoint` is updated to match.
+int openSocket(Endpoint& endpoint, int type);
+
+// Formats "ip:port" or "[ip6]:port" for logging; addresses are only turned into text
+// when needed. IPv4-mapped IPv6 addresses are shown as plain IPv4.
+std::string formatAddress(const sockaddr_storage& addr);
+
+#endif // ENDPOINT_HPP
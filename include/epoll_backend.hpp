@@ -0,0 +1,107 @@
+#ifndef EPOLL_BACKEND_HPP
+#define EPOLL_BACKEND_HPP
+
+#include <array>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include "io_backend.hpp"
+#include "buffer_pool.hpp"
+
+// Readiness-based backend: edge-triggered epoll plus non-blocking accept/recv/sendmsg.
+// Data is received straight into the client's InputBuffer, and the output queue leaves in
+// scatter-gather batches. Shared slices of at least --zerocopy bytes are sent with
+// MSG_ZEROCOPY; their chunks stay referenced until the kernel reports it is done with them.
+class EpollBackend : public IoBackend
+{
+public:
+    explicit EpollBackend(Reactor& reactor);
+    ~EpollBackend() override;
+
+    const char* name() const override { return "epoll"; }
+
+    bool start(const std::vector<int>& tcp_sockets, const std::vector<int>& udp_sockets,
+               int wake_fd, int signal_fd) override;
+    void stopListening() override;
+
+    bool addClient(ClientInfo& client) override;
+    void removeClient(ClientInfo& client) override;
+    void resumeRead(ClientInfo& client) override;
+    void flush(ClientInfo& client) override;
+    size_t pendingOutput(const ClientInfo& client) const override;
+
+    bool wait(int timeout_ms) override;
+    bool ready() const override { return _ready > 0 || _accept_pending; }
+    size_t dispatch() override;
+
+private:
+    struct Listener
+    {
+        int fd;
+        bool pending = false;   // connections may be waiting beyond the last accept budget
+    };
+
+    // Tokens of the reactor's own fds: generation 0, and the kind in the top byte.
+    enum Tag : uint64_t
+    {
+        TAG_LISTENER = 1,       // low bits: index in _listeners
+        TAG_UDP,                // low bits: fd
+        TAG_WAKE,
+        TAG_SIGNAL,
+        TAG_RETIRED             // low bits: fd of a closed connection's retired socket
+    };
+    static uint64_t tag(Tag kind, uint64_t value) { return (static_cast<uint64_t>(kind) << 56) | value; }
+
+    bool watch(int fd, uint64_t token, const char* what);
+    void acceptConnections(size_t listener);
+    void readClient(ClientInfo& client);
+    void updateWriteInterest(ClientInfo& client);
+    // Large slices to this client go out with MSG_ZEROCOPY.
+    bool zeroCopy(const ClientInfo& client) const;
+    struct ZeroCopyState;
+    // Releases chunks of completed zero-copy sends. False if the socket has a real error.
+    bool drainZeroCopy(int fd, ZeroCopyState& state);
+    // Keeps a closing connection's socket open under a descriptor of its own until the
+    // kernel reports its zero-copy sends complete.
+    void retireZeroCopy(ClientInfo& client);
+    void drainRetired(int fd);
+
+private:
+    Reactor& _reactor;
+    int _epoll_fd = -1;
+    std::vector<Listener> _listeners;
+
+    // Connections accepted per listener and dispatch; more waiting ones are taken next
+    // time, so a connection storm cannot starve established clients.
+    size_t _accept_budget;
+    bool _accept_pending = false;   // some listener is pending
+
+    static constexpr int MAX_EVENTS = 64;
+    std::array<epoll_event, MAX_EVENTS> _events;
+    int _ready = 0;
+
+    // Zero-copy sends the kernel may still read from
+    struct ZeroCopyState
+    {
+        uint32_t next_id = 0;   // the kernel numbers a socket's zero-copy sends from 0
+        std::deque<std::pair<uint32_t, ChunkRef>> pending;
+    };
+    std::vector<ZeroCopyState> _zerocopy;   // of open connections, by ClientInfo::slot
+    size_t _zerocopy_min = 0;               // 0: MSG_ZEROCOPY off
+    // Sockets of closed connections with zero-copy sends pending, by fd
+    std::unordered_map<int, ZeroCopyState> _retired;
+    // Chunks of sends whose socket could not be retired; never reused.
+    std::vector<ChunkRef> _abandoned;
+
+    static constexpr size_t MAX_IOV = 64;
+    // Pause before accepting again once the process is out of descriptors or memory.
+    static constexpr uint64_t ACCEPT_RETRY_MS = 100;
+    // A retired socket whose peer acknowledges nothing for this long is reset, which
+    // completes its zero-copy sends (TCP_USER_TIMEOUT).
+    static constexpr unsigned ZEROCOPY_RETIRE_TIMEOUT_MS = 60000;
+};
+
+#endif // EPOLL_BACKEND_HPP
@@ -0,0 +1,75 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Header of the length-prefixed binary protocol.
+//
+// A TCP connection whose first byte is MAGIC speaks frames instead of text lines for its
+// whole life; a UDP datagram starting with MAGIC carries exactly one frame. Every frame is
+// a fixed header followed by `length` payload bytes, all integers in network byte order:
+//
+//     0  u32 length       payload bytes after the header
+//     4  u32 request_id   chosen by the client, copied into the reply
+//     8  u8  opcode       OP_ECHO, OP_COMMAND, OP_MESSAGE or OP_COMMAND_BASE + command index
+//     9  u8  status       0 in requests; STATUS_OK or STATUS_ERROR in replies
+//
+// Replies carry the opcode and request id of their request, so a client may match them
+// to requests regardless of the order they arrive in. UDP replies start with MAGIC too.
+// Messages published to a channel the client subscribed to arrive as OP_MESSAGE frames
+// with request id 0.
+struct FrameHeader
+{
+    static constexpr unsigned char MAGIC = 0xB1;    // never starts a line of UTF-8 text
+    static constexpr size_t SIZE = 10;
+
+    static constexpr uint8_t OP_ECHO = 0x00;            // payload is sent back
+    static constexpr uint8_t OP_COMMAND = 0x01;         // payload is a command line, e.g. "/time"
+    static constexpr uint8_t OP_MESSAGE = 0x02;         // server push; payload is "<channel> <message>"
+    static constexpr uint8_t OP_COMMAND_BASE = 0x10;    // + registration index; payload holds the arguments
+
+    static constexpr uint8_t STATUS_OK = 0;
+    static constexpr uint8_t STATUS_ERROR = 1;
+
+    uint32_t length = 0;
+    uint32_t request_id = 0;
+    uint8_t opcode = 0;
+    uint8_t status = 0;
+
+    static FrameHeader decode(const char* data)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        FrameHeader header;
+        header.length = readU32(p);
+        header.request_id = readU32(p + 4);
+        header.opcode = p[8];
+        header.status = p[9];
+        return header;
+    }
+
+    void encode(char* data) const
+    {
+        unsigned char* p = reinterpret_cast<unsigned char*>(data);
+        writeU32(p, length);
+        writeU32(p + 4, request_id);
+        p[8] = opcode;
+        p[9] = status;
+    }
+
+private:
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return (uint32_t{ p[0] } << 24) | (uint32_t{ p[1] } << 16) | (uint32_t{ p[2] } << 8) | p[3];
+    }
+
+    static void writeU32(unsigned char* p, uint32_t value)
+    {
+        p[0] = static_cast<unsigned char>(value >> 24);
+        p[1] = static_cast<unsigned char>(value >> 16);
+        p[2] = static_cast<unsigned char>(value >> 8);
+        p[3] = static_cast<unsigned char>(value);
+    }
+};
+
+#endif // FRAME_HPP
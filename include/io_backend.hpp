@@ -0,0 +1,62 @@
+#ifndef IO_BACKEND_HPP
+#define IO_BACKEND_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class Reactor;
+struct ClientInfo;
+
+// How a reactor waits for and moves socket I/O.
+//
+// The reactor keeps the protocol: lines, commands, deadlines, back-pressure. A backend
+// owns the syscalls that accept connections and move bytes between the sockets and the
+// client buffers, and reports what happened through the reactor's backend callbacks.
+// Every call comes from the reactor's own thread.
+class IoBackend
+{
+public:
+    virtual ~IoBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    // Starts watching the reactor's listening TCP sockets, its UDP sockets, the eventfd
+    // other threads use to wake it and, on one reactor, the server's signalfd (else -1).
+    virtual bool start(const std::vector<int>& tcp_sockets, const std::vector<int>& udp_sockets,
+                       int wake_fd, int signal_fd) = 0;
+    // Stops accepting connections; the reactor closes its listeners right after.
+    virtual void stopListening() = 0;
+
+    virtual bool addClient(ClientInfo& client) = 0;
+    // Stops all I/O on the connection; the reactor closes its fd right after.
+    virtual void removeClient(ClientInfo& client) = 0;
+    // Delivers data again after the reactor cleared client.read_paused.
+    virtual void resumeRead(ClientInfo& client) = 0;
+    // Starts sending client.output. Sets client.write_failed if the connection broke.
+    virtual void flush(ClientInfo& client) = 0;
+    // Bytes accepted for sending that the kernel has not taken yet.
+    virtual size_t pendingOutput(const ClientInfo& client) const = 0;
+
+    // Waits up to `timeout_ms` (-1: no limit) for I/O. Returns false on a fatal error.
+    virtual bool wait(int timeout_ms) = 0;
+    // The last wait() collected something for dispatch().
+    virtual bool ready() const = 0;
+    // Reports everything the last wait() collected to the reactor; returns how many events.
+    virtual size_t dispatch() = 0;
+};
+
+enum class IoBackendKind
+{
+    Epoll,
+    Uring
+};
+
+bool parseIoBackend(const std::string& name, IoBackendKind& kind);
+
+// io_uring needs Linux 5.19 (6.0 for multishot recv); where the kernel refuses the ring,
+// or io_uring is disabled, the reactor falls back to epoll.
+std::unique_ptr<IoBackend> makeIoBackend(IoBackendKind kind, Reactor& reactor);
+
+#endif // IO_BACKEND_HPP
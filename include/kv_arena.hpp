@@ -0,0 +1,54 @@
+#ifndef KV_ARENA_HPP
+#define KV_ARENA_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+// Memory for the records of one key-value shard.
+//
+// Blocks come in power-of-two size classes carved from large slabs, and freed blocks go
+// onto their class's free list for the next record of that size, so a steady workload
+// stops calling the allocator and records of a shard sit close together. Blocks above the
+// largest class are allocated individually. Slab memory is kept for reuse, not returned.
+// Not thread-safe: the shard's lock covers it.
+class KvArena
+{
+public:
+    KvArena() = default;
+    ~KvArena();
+
+    KvArena(const KvArena&) = delete;
+    KvArena& operator=(const KvArena&) = delete;
+
+    // A block of at least `size` bytes; `capacity` gets its actual size.
+    void* allocate(size_t size, size_t& capacity);
+    // Returns a block from allocate() with the capacity it reported.
+    void release(void* block, size_t capacity);
+
+    size_t reserved() const { return _reserved; }   // bytes taken from the system
+    size_t used() const { return _used; }           // of which in live blocks
+
+private:
+    static size_t sizeClass(size_t size);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    static constexpr size_t MIN_SHIFT = 5;                  // 32 bytes
+    static constexpr size_t CLASSES = 12;                   // up to 64 KiB
+    static constexpr size_t SLAB_SIZE = size_t{ 1 } << 18;  // 256 KiB
+
+    std::array<FreeBlock*, CLASSES> _free{};
+    std::array<char*, CLASSES> _cursor{};                   // unused tail of the class's slab
+    std::array<char*, CLASSES> _end{};
+    std::vector<std::unique_ptr<char[]>> _slabs;
+    size_t _reserved = 0;
+    size_t _used = 0;
+};
+
+#endif // KV_ARENA_HPP
@@ -0,0 +1,105 @@
+#ifndef KV_STORE_HPP
+#define KV_STORE_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "kv_table.hpp"
+
+// Totals over all shards of a KvStore.
+struct KvStats
+{
+    uint64_t keys = 0;
+    uint64_t memory = 0;        // bytes of slot arrays and arena slabs
+    uint64_t hits = 0;          // reads that found their key
+    uint64_t misses = 0;
+    uint64_t expired = 0;       // keys removed because their TTL ran out
+};
+
+// In-memory key-value store behind the /set, /get, /del, /incr and /expire commands.
+//
+// Keys are spread over independent shards by hash, each a KvTable behind its own lock, so
+// reactors working on different keys rarely meet on a lock and never on a cache line.
+// Expiry is lazy, on access, plus sampled: expireSample() looks at a slice of each shard
+// and removes what has run out, so keys nobody reads again still go away. Times are
+// monotonic milliseconds; every method may be called from any thread.
+class KvStore
+{
+public:
+    enum class IncrResult
+    {
+        Ok,
+        NotInteger,
+        Overflow
+    };
+
+    explicit KvStore(size_t shards);
+
+    void set(std::string_view key, std::string_view value, uint64_t now_ms);
+    // Calls `read(value)` under the shard's lock if `key` is present.
+    template <typename Read>
+    bool get(std::string_view key, uint64_t now_ms, Read&& read);
+    bool del(std::string_view key, uint64_t now_ms);
+    // Adds `delta` to the decimal integer in `key`, which starts at 0 if absent.
+    IncrResult incr(std::string_view key, int64_t delta, uint64_t now_ms, int64_t& value);
+    // Sets the key to expire `ttl_ms` from now, or removes it right away if `ttl_ms` is 0.
+    // False if there is no such key.
+    bool expire(std::string_view key, uint64_t ttl_ms, uint64_t now_ms);
+
+    // Removes expired keys from a sample of every shard; returns how many.
+    size_t expireSample(uint64_t now_ms);
+    // Any keys with a TTL left, i.e. whether expireSample() has work to do.
+    bool hasExpiring() const { return _expiring.load(std::memory_order_relaxed) > 0; }
+
+    KvStats stats() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        KvTable table;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t expired = 0;
+        size_t expiring = 0;    // keys with a TTL
+    };
+
+    static uint64_t hash(std::string_view key);
+    Shard& shardOf(uint64_t hash) { return _shards[static_cast<size_t>(hash >> 40) & _shard_mask]; }
+    // The slot of `key` in `shard`, after removing the key if it has expired.
+    KvEntry** findLive(Shard& shard, std::string_view key, uint64_t hash, uint64_t now_ms);
+    void erase(Shard& shard, KvEntry** slot);
+    void setDeadline(Shard& shard, KvEntry& entry, uint64_t expires_ms);
+
+private:
+    std::unique_ptr<Shard[]> _shards;
+    size_t _shard_count;
+    size_t _shard_mask;
+    std::atomic<size_t> _expiring{ 0 };     // keys with a TTL, over all shards
+
+    static constexpr size_t SAMPLE_SLOTS = 64;      // per shard and round
+    static constexpr size_t SAMPLE_ROUNDS = 4;
+};
+
+template <typename Read>
+bool KvStore::get(std::string_view key, uint64_t now_ms, Read&& read)
+{
+    uint64_t h = hash(key);
+    Shard& shard = shardOf(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    KvEntry** slot = findLive(shard, key, h, now_ms);
+    if (slot == nullptr)
+    {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    read((*slot)->valueView());
+    return true;
+}
+
+#endif // KV_STORE_HPP
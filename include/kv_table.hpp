@@ -0,0 +1,120 @@
+#ifndef KV_TABLE_HPP
+#define KV_TABLE_HPP
+
+#include <memory>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "kv_arena.hpp"
+
+// A key with its value, in one arena block: the header, then the key bytes, then the value.
+struct KvEntry
+{
+    uint64_t hash;
+    uint64_t expires_ms;        // monotonic deadline, 0: none
+    uint32_t key_len;
+    uint32_t value_len;
+    size_t capacity;            // of the block
+
+    char* key() { return reinterpret_cast<char*>(this + 1); }
+    char* value() { return key() + key_len; }
+    std::string_view keyView() { return std::string_view(key(), key_len); }
+    std::string_view valueView() { return std::string_view(value(), value_len); }
+};
+
+// Open-addressing hash table in the style of SwissTable.
+//
+// Slots are split into groups of 16 with one control byte each: EMPTY, DELETED, or the low
+// 7 bits of the key's hash. A lookup picks a group from the rest of the hash and compares
+// all 16 control bytes with one SSE2 instruction, so entries whose tag differs are never
+// touched, and it stops at the first group with an empty slot; groups are probed
+// quadratically. Erasing leaves a tombstone only in a group that is full.
+//
+// Growing never rehashes everything at once: the old slot array stays alive and every
+// operation moves a few of its groups over, and lookups check both arrays until it is
+// empty. Entries live in the table's KvArena. Not thread-safe.
+class KvTable
+{
+public:
+    KvTable() = default;
+
+    KvTable(const KvTable&) = delete;
+    KvTable& operator=(const KvTable&) = delete;
+    ~KvTable();
+
+    // The slot holding `key`, or nullptr. Slots stay valid until the next call that
+    // inserts or erases.
+    KvEntry** find(std::string_view key, uint64_t hash);
+    // Adds `key`, which must not be present, with room for a `value_len`-byte value.
+    KvEntry** insert(std::string_view key, uint64_t hash, size_t value_len);
+    // Makes room for a `value_len`-byte value in the entry of `slot`, moving it if needed.
+    KvEntry* reserveValue(KvEntry** slot, size_t value_len);
+    void erase(KvEntry** slot);
+
+    // Calls `visit(entry)` for up to `count` slots, continuing where the previous call
+    // stopped; entries for which it returns true are erased.
+    template <typename Visit>
+    void sample(size_t count, Visit&& visit);
+
+    size_t size() const { return _table.size + _old.size; }
+    // Bytes held by the slot arrays and the arena.
+    size_t memory() const;
+
+    static constexpr size_t GROUP = 16;
+
+private:
+    struct Slots
+    {
+        std::unique_ptr<int8_t[]> ctrl;     // one control byte per slot
+        std::unique_ptr<KvEntry*[]> entries;
+        size_t capacity = 0;                // a power of two, at least GROUP
+        size_t size = 0;
+        size_t growth_left = 0;             // inserts into EMPTY slots before 7/8 load
+
+        void allocate(size_t slots);
+        void release();
+    };
+
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t MIN_CAPACITY = 64;
+    static constexpr size_t MIGRATE_GROUPS = 4;     // moved per operation while growing
+
+    static KvEntry** lookup(Slots& slots, std::string_view key, uint64_t hash);
+    static size_t place(Slots& slots, uint64_t hash);
+    static void clear(Slots& slots, size_t index);
+
+    void grow();
+    void migrate(size_t groups);
+    KvEntry* allocateEntry(std::string_view key, uint64_t hash, size_t value_len);
+
+private:
+    Slots _table;
+    Slots _old;                 // being moved into _table; empty otherwise
+    size_t _migrated = 0;       // groups of _old already moved
+    size_t _cursor = 0;         // next slot for sample()
+    KvArena _arena;
+};
+
+template <typename Visit>
+void KvTable::sample(size_t count, Visit&& visit)
+{
+    if (_old.capacity != 0)
+    {
+        migrate(MIGRATE_GROUPS);
+    }
+    if (_table.capacity == 0)
+        return;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t index = _cursor;
+        _cursor = (_cursor + 1) & (_table.capacity - 1);
+        if (_table.ctrl[index] >= 0 && visit(*_table.entries[index]))
+        {
+            erase(&_table.entries[index]);
+        }
+    }
+}
+
+#endif // KV_TABLE_HPP
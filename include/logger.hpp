@@ -0,0 +1,153 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warn,
+    Error
+};
+
+bool parseLogLevel(const std::string& name, LogLevel& level);
+
+// Per-call-site limiter: at most `limit` records per second, the rest are counted and
+// reported with the first record of the next second.
+class LogRateLimit
+{
+public:
+    // Returns true if the record may be written; `suppressed` receives the number of
+    // records dropped in the previous window when a new window starts.
+    bool allow(uint64_t now_s, uint32_t limit, uint32_t& suppressed);
+
+private:
+    std::atomic<uint64_t> _window{ 0 };
+    std::atomic<uint32_t> _count{ 0 };
+    std::atomic<uint32_t> _suppressed{ 0 };
+};
+
+// Fixed-size binary log record; the text is formatted by the producing thread, the
+// timestamp only when the record is written out.
+struct LogRecord
+{
+    uint64_t timestamp_ns;
+    uint16_t length;
+    LogLevel level;
+    char text[245];
+};
+
+// Single-producer/single-consumer ring owned by one logging thread.
+class LogRing
+{
+public:
+    bool push(LogLevel level, uint64_t timestamp_ns, const char* text, size_t length);
+
+    template <typename Fn>
+    size_t drain(Fn&& fn)
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        uint64_t tail = _tail.load(std::memory_order_acquire);
+        for (uint64_t i = head; i < tail; ++i)
+        {
+            fn(_records[i & (CAPACITY - 1)]);
+        }
+        _head.store(tail, std::memory_order_release);
+        return static_cast<size_t>(tail - head);
+    }
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    LogRing* next = nullptr;    // in the Logger's list of rings, set before it is published
+
+private:
+    static constexpr size_t CAPACITY = 1024;
+
+    alignas(64) std::atomic<uint64_t> _head{ 0 };   // next record to read (consumer)
+    alignas(64) std::atomic<uint64_t> _tail{ 0 };   // next record to write (producer)
+    std::atomic<uint64_t> _dropped{ 0 };
+    LogRecord _records[CAPACITY];
+};
+
+// Asynchronous logger.
+//
+// Every thread formats its records into its own LogRing, so logging from a reactor is a
+// vsnprintf and a few relaxed atomics; it never takes a lock and never waits. A thread's
+// first record allocates its ring and links it into a lock-free list. When a ring is full
+// the record is dropped and counted. A background thread collects the rings every few
+// milliseconds and writes them out in large batches; once they stay empty it sleeps on an
+// eventfd, and the first record after that wakes it with one non-blocking write.
+class Logger
+{
+public:
+    static Logger& instance();
+
+    // Opens the output (stdout when `path` is empty) and starts the writer thread.
+    bool start(const std::string& path, LogLevel level, uint32_t rate_limit);
+    // Writes out everything still queued and stops the writer thread. Call it once the
+    // other threads are done logging; records logged afterwards are written out directly
+    // by the thread that logs them.
+    void stop();
+
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<uint8_t>(level) >= _level.load(std::memory_order_relaxed);
+    }
+
+    void log(LogLevel level, LogRateLimit& limit, const char* format, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    // Any thread, without locking.
+    uint64_t dropped() const;
+    uint64_t suppressed() const { return _suppressed.load(std::memory_order_relaxed); }
+
+private:
+    Logger() = default;
+    ~Logger();
+
+    LogRing& localRing();
+    void writerLoop();
+    size_t flush(std::string& batch);
+    void writeOut(const std::string& batch);
+    void wakeWriter();
+
+private:
+    std::atomic<uint8_t> _level{ static_cast<uint8_t>(LogLevel::Info) };
+    std::atomic<uint32_t> _rate_limit{ 100 };
+    std::atomic<uint64_t> _suppressed{ 0 };
+
+    std::atomic<LogRing*> _rings{ nullptr };    // one per logging thread, newest first
+
+    int _fd = 1;                        // open until the logger is destroyed
+    std::thread _writer;
+    std::atomic<bool> _running{ false };
+    std::atomic<bool> _stopped{ false };    // stop() ran: log() writes records itself
+
+    std::atomic<bool> _idle{ false };   // the writer sleeps on _wake_fd until a record arrives
+    // eventfd, created by start() before any thread that logs and closed only by ~Logger,
+    // so a producer never writes to a descriptor being closed or reused.
+    int _wake_fd = -1;
+
+    static constexpr int FLUSH_INTERVAL_MS = 5;
+};
+
+#define LOG_AT(level, ...)                                                  \
+    do                                                                      \
+    {                                                                       \
+        if (Logger::instance().enabled(level))                              \
+        {                                                                   \
+            static LogRateLimit log_rate_limit_;                            \
+            Logger::instance().log(level, log_rate_limit_, __VA_ARGS__);    \
+        }                                                                   \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+#endif // LOGGER_HPP
@@ -0,0 +1,50 @@
+#ifndef LOOP_CLOCK_HPP
+#define LOOP_CLOCK_HPP
+
+#include <chrono>
+#include <string_view>
+#include <cstdint>
+#include <ctime>
+
+// Time as one event loop sees it.
+//
+// Both clocks are read once per loop iteration, and everything the iteration does (timeouts,
+// rate limits, connection timestamps, log records, /time) uses those readings. The local
+// wall time is also kept rendered as "YYYY-mm-dd HH:MM:SS" and only rendered again when
+// the second changes, so answering /time is a copy. Owned by the loop's thread.
+class LoopClock
+{
+public:
+    LoopClock() { update(); }
+
+    // Reads the monotonic and the (coarse) wall clock.
+    void update();
+
+    uint64_t ms() const { return _ms; }                     // monotonic milliseconds
+    uint64_t wallNs() const { return _wall_ns; }            // nanoseconds since the epoch
+    std::chrono::system_clock::time_point wallTime() const
+    {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(_wall_ns)));
+    }
+    // Local time of the last update(), "YYYY-mm-dd HH:MM:SS".
+    std::string_view localTime() const { return std::string_view(_text, _length); }
+
+    // The clock of the loop running on the calling thread, or nullptr.
+    static const LoopClock* current() { return _current; }
+    static void setCurrent(const LoopClock* clock) { _current = clock; }
+
+private:
+    uint64_t _ms = 0;
+    uint64_t _wall_ns = 0;
+    time_t _rendered_second = -1;
+    char _text[32] = "";
+    size_t _length = 0;
+
+    static thread_local const LoopClock* _current;
+};
+
+uint64_t monotonicMs();
+uint64_t monotonicNs();
+
+#endif // LOOP_CLOCK_HPP
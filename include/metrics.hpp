@@ -0,0 +1,121 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Counter that is written only by the owning reactor thread and read by others.
+// Updates are plain relaxed load/store pairs, so the hot path never issues a locked instruction.
+class ShardCounter
+{
+public:
+    void add(uint64_t n = 1) { _value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void sub(uint64_t n = 1) { _value.store(_value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); }
+    void set(uint64_t n) { _value.store(n, std::memory_order_relaxed); }
+    uint64_t load() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _value{ 0 };
+};
+
+// Histogram with power-of-two buckets, written like ShardCounter by one thread only.
+// Bucket 0 counts zeros and bucket i > 0 counts values in [2^(i-1), 2^i).
+class ShardHistogram
+{
+public:
+    static constexpr size_t BUCKETS = 48;   // the last one also takes everything larger
+
+    void observe(uint64_t value);
+
+    uint64_t bucket(size_t i) const { return _buckets[i].load(); }
+    uint64_t count() const { return _count.load(); }
+    uint64_t sum() const { return _sum.load(); }
+
+    // Largest value bucket `i` can hold.
+    static uint64_t upperBound(size_t i) { return i == 0 ? 0 : (uint64_t{ 1 } << i) - 1; }
+
+private:
+    std::array<ShardCounter, BUCKETS> _buckets;
+    ShardCounter _count;
+    ShardCounter _sum;
+};
+
+// Sum of histograms from several shards, read without locks. Concurrent updates may be
+// seen partially, which only matters at the precision of one sample.
+struct HistogramSnapshot
+{
+    std::array<uint64_t, ShardHistogram::BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    void add(const ShardHistogram& histogram);
+    // Upper bound of the bucket holding quantile `q` (0..1); 0 when empty.
+    uint64_t quantile(double q) const;
+};
+
+// Everything one reactor measures. Each reactor owns one and is its only writer, and the
+// shard starts on its own cache line so reactors never write to the same line. Readers
+// add the shards up with relaxed loads.
+struct alignas(64) MetricsShard
+{
+    ShardCounter accepted;          // TCP connections accepted
+    ShardCounter closed;            // TCP connections closed
+    ShardCounter rejected;          // TCP connections reset at the connection limit
+    ShardCounter open_connections;
+    ShardCounter udp_peers;         // UDP peers currently tracked
+    ShardCounter udp_peers_seen;    // UDP peers ever tracked
+    ShardCounter udp_expired;
+    ShardCounter udp_evicted;
+
+    ShardCounter messages;          // non-empty lines and datagrams handled
+    ShardCounter commands;          // of which slash commands
+    ShardCounter offloaded;         // commands run on the worker pool
+    ShardCounter bytes_in;          // TCP and UDP payload bytes received
+    ShardCounter bytes_out;         // and sent
+    ShardCounter tcp_responses;     // replies queued on TCP connections
+    ShardCounter tcp_writes;        // send calls that carried them
+    ShardCounter limited_tcp;       // messages held back by a connection's rate limit
+    ShardCounter limited_udp;       // datagrams dropped or rejected by a peer's rate limit
+    ShardCounter limited_commands;  // commands held back by the command's rate limit
+    ShardCounter subscriptions;     // pub/sub subscriptions currently held
+    ShardCounter pubsub_delivered;  // published messages queued to a subscriber
+    ShardCounter pubsub_dropped;    // and skipped because the subscriber was too slow
+    ShardCounter spin_ns;           // --low-latency: time polling for events without sleeping
+    ShardCounter sleep_ns;          // and blocked waiting for them
+    ShardCounter spin_hits;         // polls that found events within the budget
+
+    ShardHistogram loop_events;     // I/O events handled per backend wakeup
+    ShardHistogram queue_depth;     // bytes queued on a connection when its replies are flushed
+
+    // Latency of each registered command, by registration index, in nanoseconds
+    static constexpr size_t MAX_TIMED_COMMANDS = 32;
+    std::array<ShardHistogram, MAX_TIMED_COMMANDS> command_ns;
+};
+
+// Appends samples in the Prometheus text exposition format (version 0.0.4).
+class PrometheusWriter
+{
+public:
+    explicit PrometheusWriter(std::string& out) : _out{ out } {}
+
+    void header(std::string_view name, std::string_view type, std::string_view help);
+    // `labels` is the inside of the braces, e.g. reactor="0"; empty for none.
+    void sample(std::string_view name, std::string_view labels, uint64_t value);
+    void sample(std::string_view name, std::string_view labels, double value);
+    // Cumulative buckets, _sum and _count; values are multiplied by `unit` (e.g. 1e-9 s/ns).
+    void histogram(std::string_view name, std::string_view labels, const HistogramSnapshot& histogram,
+                   double unit);
+
+private:
+    void series(std::string_view name, std::string_view suffix, std::string_view labels,
+                std::string_view extra);
+
+private:
+    std::string& _out;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,44 @@
+#ifndef METRICS_HTTP_HPP
+#define METRICS_HTTP_HPP
+
+#include <string>
+#include <thread>
+
+class NetworkServer;
+
+// Minimal HTTP endpoint that answers GET /metrics for a local Prometheus.
+//
+// It runs on its own thread with blocking sockets: scrapes are rare and small, and the
+// reactors never wait for it. Rendering only reads the reactors' metric shards. Each
+// response closes its connection.
+class MetricsHttpServer
+{
+public:
+    explicit MetricsHttpServer(NetworkServer& server);
+    ~MetricsHttpServer();
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+
+    // Binds 127.0.0.1:`port`.
+    bool listen(int port);
+    void start();
+    // Any thread: makes the serving thread exit.
+    void stop();
+    // Waits for the thread, which exits once stop() is called.
+    void join();
+
+private:
+    void run();
+    void serve(int fd);
+
+private:
+    NetworkServer& _server;
+    int _socket = -1;
+    int _stop_fd = -1;      // eventfd written by stop()
+    std::thread _thread;
+
+    static constexpr size_t MAX_REQUEST = 8192;
+};
+
+#endif // METRICS_HTTP_HPP
@@ -0,0 +1,46 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+
+// Multi-producer, single-consumer queue of heap nodes linked through their `next` member.
+//
+// Producers push with one compare-and-swap on an intrusive list head; the owning reactor
+// takes the whole list with one exchange and reverses it into push order. Neither side
+// ever blocks the other.
+template <typename Node>
+class MpscQueue
+{
+public:
+    // Any thread. True if the queue was empty, i.e. the consumer needs a wakeup.
+    bool push(Node* node)
+    {
+        Node* head = _head.load(std::memory_order_relaxed);
+        do
+        {
+            node->next = head;
+        } while (!_head.compare_exchange_weak(head, node, std::memory_order_release,
+                                              std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    // Consumer only. Everything pushed so far, oldest first, linked through `next`.
+    Node* takeAll()
+    {
+        Node* list = _head.exchange(nullptr, std::memory_order_acquire);
+        Node* ordered = nullptr;
+        while (list)
+        {
+            Node* next = list->next;
+            list->next = ordered;
+            ordered = list;
+            list = next;
+        }
+        return ordered;
+    }
+
+private:
+    std::atomic<Node*> _head{ nullptr };
+};
+
+#endif // MPSC_QUEUE_HPP
@@ -2,11 +2,11 @@
 #define PARSER_HPP
 
 #include <string>
+#include "config.hpp"
 
-struct CommandLineArgs 
+struct CommandLineArgs
 {
-    int tcp_port = 8080;
-    int udp_port = 8081;
+    ServerConfig config;
     bool show_help = false;
     bool error = false;
     std::string error_msg;
@@ -15,4 +15,4 @@ struct CommandLineArgs
 CommandLineArgs parseArguments(int argc, char* argv[]);
 void printUsage(const char* program_name);
 
-#endif // PARSER_HPP
\ No newline at end of file
+#endif // PARSER_HPP
@@ -0,0 +1,91 @@
+#ifndef PEER_TABLE_HPP
+#define PEER_TABLE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "token_bucket.hpp"
+
+// IPv6 address and port of a UDP peer; IPv4 peers use their IPv4-mapped address.
+struct UdpPeerKey
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+    uint16_t port = 0;      // 0 marks an empty slot: no datagram comes from port 0
+
+    bool empty() const { return port == 0; }
+    bool operator==(const UdpPeerKey& other) const
+    {
+        return high == other.high && low == other.low && port == other.port;
+    }
+
+    // Fibonacci hashing spreads neighbouring addresses and ports; take the high bits.
+    uint64_t hash() const
+    {
+        uint64_t mixed = (high * 0xC2B2AE3D27D4EB4Full) ^ low ^ (static_cast<uint64_t>(port) << 48);
+        return mixed * 0x9E3779B97F4A7C15ull;
+    }
+};
+
+// Hasher for standard containers keyed on UdpPeerKey.
+struct UdpPeerKeyHash
+{
+    size_t operator()(const UdpPeerKey& key) const { return static_cast<size_t>(key.hash() >> 16); }
+};
+
+struct UdpPeer
+{
+    UdpPeerKey key;
+    uint64_t last_seen_ms;
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+    uint64_t packets_received;
+    uint64_t packets_sent;
+    TokenBucket rate_bucket;        // --udp-rate
+};
+
+// Fixed-capacity table of UDP peers for one reactor.
+//
+// Open addressing with linear probing over a power-of-two slot array kept at most half
+// full, keyed on the binary address and port, so lookups never allocate and memory is
+// bounded up front. Deletion uses backward shifting, so there are no tombstones.
+// Peers idle for longer than the timeout are dropped by expire(); when the table is full
+// a new peer replaces the least recently seen of a small sample of entries.
+class UdpPeerTable
+{
+public:
+    UdpPeerTable(size_t capacity, uint64_t idle_timeout_ms);
+
+    static UdpPeerKey makeKey(const sockaddr_storage& addr);
+
+    // Finds the peer or inserts a fresh record for it; `inserted` tells which.
+    UdpPeer& touch(const UdpPeerKey& key, uint64_t now_ms, bool& inserted);
+
+    bool contains(const UdpPeerKey& key) const;
+
+    // Removes every peer idle for longer than the timeout; returns how many were removed.
+    size_t expire(uint64_t now_ms);
+
+    size_t size() const { return _size; }
+    size_t capacity() const { return _capacity; }
+    uint64_t evicted() const { return _evicted; }
+
+private:
+    size_t home(const UdpPeerKey& key) const;
+    void erase(size_t slot);
+    size_t evictOldest(size_t start);
+
+private:
+    std::vector<UdpPeer> _slots;
+    size_t _mask;
+    size_t _capacity;
+    size_t _size = 0;
+    uint64_t _idle_timeout_ms;
+    uint64_t _evicted = 0;
+
+    static constexpr size_t EVICTION_SAMPLE = 8;
+};
+
+#endif // PEER_TABLE_HPP
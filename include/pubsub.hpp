@@ -0,0 +1,209 @@
+#ifndef PUBSUB_HPP
+#define PUBSUB_HPP
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include "peer_table.hpp"
+
+// What happens to a publication for a subscriber whose output is at the high-water mark.
+enum class SlowSubscriber : uint8_t
+{
+    Drop,           // the subscriber misses the message
+    Disconnect      // the subscriber is closed
+};
+
+inline bool parseSlowSubscriber(const std::string& name, SlowSubscriber& policy)
+{
+    if (name == "drop") policy = SlowSubscriber::Drop;
+    else if (name == "disconnect") policy = SlowSubscriber::Disconnect;
+    else return false;
+    return true;
+}
+
+// A published message. Built once by the publishing reactor and shared read-only by every
+// reactor it is delivered to.
+struct Publication
+{
+    std::string channel;
+    std::string message;
+};
+
+// A publication on its way to one reactor.
+struct PublicationDelivery
+{
+    PublicationDelivery* next = nullptr;    // link in an MpscQueue
+    std::shared_ptr<const Publication> publication;
+};
+
+// One channel a client or peer is subscribed to. `serial` is unique per subscribe call,
+// so an entry left behind in a channel by an earlier subscription never matches.
+struct Subscription
+{
+    uint32_t channel;
+    uint64_t serial;
+};
+
+// Channels and their subscribers on one reactor.
+//
+// Each channel keeps its subscribers in flat arrays of small records (a connection token,
+// or a peer key, plus the serial), so a publication walks them in one sequential pass.
+// Leaving is O(1): the subscriber's own list of Subscriptions is the truth, and array
+// entries that no longer match it are dropped by the next pass over the channel. Passes
+// are also forced once stale entries outnumber live ones, so churn without publications
+// cannot grow the arrays. Only the owning reactor's thread may use the table.
+class ChannelTable
+{
+public:
+    struct TcpSubscriber
+    {
+        uint64_t token;
+        uint64_t serial;
+    };
+
+    struct UdpSubscriber
+    {
+        UdpPeerKey key;
+        uint64_t serial;
+    };
+
+    // Where a UDP peer receives its messages, and what it is subscribed to.
+    struct UdpPeerSubscriptions
+    {
+        sockaddr_storage addr;
+        socklen_t addr_len;
+        int socket;             // the socket the peer subscribed through
+        bool framed;            // subscribed with a binary frame: messages come as frames
+        std::vector<Subscription> subscriptions;
+    };
+
+    enum class Result
+    {
+        Added,
+        Exists,
+        Full                    // the subscriber is at MAX_SUBSCRIPTIONS
+    };
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr size_t MAX_SUBSCRIPTIONS = 64;     // channels per connection or peer
+
+    // Subscribes the connection `token`, whose Subscriptions are `subscriptions`.
+    Result subscribe(std::string_view name, uint64_t token, std::vector<Subscription>& subscriptions);
+    Result subscribe(std::string_view name, const UdpPeerKey& key, const sockaddr_storage& addr,
+                     socklen_t addr_len, int socket, bool framed);
+    // Leaves channel `name`, or every channel if `name` is empty; returns how many were left.
+    size_t unsubscribe(std::vector<Subscription>& subscriptions, std::string_view name);
+    size_t unsubscribe(const UdpPeerKey& key, std::string_view name);
+
+    // Id of channel `name`, or NONE if nobody is subscribed to it.
+    uint32_t find(std::string_view name) const;
+    // True once a pass over channel `id` is due to drop its stale entries.
+    bool needsSweep(uint32_t id) const;
+
+    // Calls `tcp(subscriber)` and `udp(subscriber)` for every entry of channel `id`; the
+    // calls return false for stale entries, which are dropped in the same pass. They may
+    // unsubscribe anyone, but must not subscribe.
+    template <typename Tcp, typename Udp>
+    void forEach(uint32_t id, Tcp&& tcp, Udp&& udp);
+
+    const UdpPeerSubscriptions* udpPeer(const UdpPeerKey& key) const;
+    // Drops the subscriptions of the UDP peers for which `alive(key)` is false.
+    template <typename Alive>
+    void expireUdp(Alive&& alive);
+
+    static bool contains(const std::vector<Subscription>& subscriptions, uint32_t channel, uint64_t serial);
+
+    size_t subscriptions() const { return _subscriptions; }    // over all channels
+    size_t channels() const { return _index.size(); }
+
+private:
+    struct Channel
+    {
+        std::string name;
+        std::vector<TcpSubscriber> tcp;
+        std::vector<UdpSubscriber> udp;
+        size_t live = 0;        // entries that are not stale
+    };
+
+    // Id of channel `name`, created if needed.
+    uint32_t open(std::string_view name);
+    // Marks one entry of `id` stale; the channel goes once none is live, unless a pass is
+    // walking it, which then removes it at its end.
+    void leave(uint32_t id);
+    void close(uint32_t id);
+
+private:
+    std::deque<Channel> _channels;                          // by id; stable addresses
+    std::unordered_map<std::string_view, uint32_t> _index;  // keys view Channel::name
+    std::vector<uint32_t> _free;                            // ids of closed channels
+    std::unordered_map<UdpPeerKey, UdpPeerSubscriptions, UdpPeerKeyHash> _udp_peers;
+    uint64_t _serial = 0;
+    size_t _subscriptions = 0;
+    uint32_t _walking = NONE;                               // channel forEach() is in
+
+    static constexpr size_t SWEEP_SLACK = 64;
+};
+
+template <typename Tcp, typename Udp>
+void ChannelTable::forEach(uint32_t id, Tcp&& tcp, Udp&& udp)
+{
+    _walking = id;
+    Channel& channel = _channels[id];
+
+    // Entries are read before the callback runs and kept in order; the callback may only
+    // make entries stale, never add or move them.
+    size_t kept = 0;
+    for (size_t i = 0; i < channel.tcp.size(); ++i)
+    {
+        TcpSubscriber subscriber = channel.tcp[i];
+        if (tcp(subscriber))
+        {
+            channel.tcp[kept++] = subscriber;
+        }
+    }
+    channel.tcp.resize(kept);
+
+    kept = 0;
+    for (size_t i = 0; i < channel.udp.size(); ++i)
+    {
+        UdpSubscriber subscriber = channel.udp[i];
+        if (udp(subscriber))
+        {
+            channel.udp[kept++] = subscriber;
+        }
+    }
+    channel.udp.resize(kept);
+
+    _walking = NONE;
+    if (channel.live == 0)
+    {
+        close(id);
+    }
+}
+
+template <typename Alive>
+void ChannelTable::expireUdp(Alive&& alive)
+{
+    for (auto it = _udp_peers.begin(); it != _udp_peers.end();)
+    {
+        if (alive(it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        for (const Subscription& subscription : it->second.subscriptions)
+        {
+            leave(subscription.channel);
+        }
+        it = _udp_peers.erase(it);
+    }
+}
+
+#endif // PUBSUB_HPP
@@ -0,0 +1,258 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "connection_table.hpp"
+#include "config.hpp"
+#include "udp_batch.hpp"
+#include "peer_table.hpp"
+#include "timer_wheel.hpp"
+#include "io_backend.hpp"
+#include "metrics.hpp"
+#include "frame.hpp"
+#include "completion_queue.hpp"
+#include "token_bucket.hpp"
+#include "loop_clock.hpp"
+#include "pubsub.hpp"
+
+class NetworkServer;
+struct CommandContext;
+
+// A connection accepted off the reactor threads, on its way into a reactor.
+struct AdoptedClient
+{
+    AdoptedClient* next = nullptr;      // link in an MpscQueue
+    int fd;
+    sockaddr_storage addr;
+    socklen_t addr_len;
+};
+
+// One independent event loop: its own I/O backend (epoll or io_uring), its own
+// SO_REUSEPORT TCP/UDP sockets on every listen endpoint and its own client tables. Reactors never touch each
+// other's state.
+class Reactor
+{
+public:
+    Reactor(NetworkServer& server, const ServerConfig& config, int id);
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // `signal_fd` is the server's signalfd for the one reactor that watches it, else -1.
+    bool initialize(int signal_fd = -1);
+    // Runs until the server stops, then drains: stops accepting, lets queued replies go out
+    // and shuts connections down as they empty, all within --drain-timeout.
+    void run();
+    // Any thread: makes the loop look at the server state and its completed commands.
+    void wake();
+
+    int id() const { return _id; }
+    const ServerConfig& config() const { return _config; }
+    // Written by this reactor's thread only; safe to read from any thread.
+    const MetricsShard& metrics() const { return _metrics; }
+    bool udpGsoEnabled() const { return _udp_batch.gsoEnabled(); }
+    const char* ioBackendName() const { return _io->name(); }
+
+    // Timers run on this reactor's thread; use them for periodic per-shard work.
+    TimerWheel& timers() { return _timers; }
+    // The loop's time; handlers read it instead of the system clocks.
+    const LoopClock& clock() const { return _clock; }
+
+    // Called by the I/O backend.
+    ClientInfo* resolve(uint64_t token) { return _connections.resolve(token); }
+    // Takes ownership of an accepted, connected socket; closes it on failure or when the
+    // reactor is at its connection limit. `ktls`: the kernel already carries its TLS session.
+    ClientInfo* acceptClient(int fd, const sockaddr_storage& addr, socklen_t addr_len, bool ktls = false);
+    // Any thread: queues a connected socket with kernel TLS set up (see TlsAcceptor) for
+    // acceptClient() on this reactor's thread.
+    void adoptClient(int fd, const sockaddr_storage& addr, socklen_t addr_len);
+    // Space for the next bytes from the client, or nullptr if it sent an over-long line
+    // and has been closed.
+    char* receiveBuffer(ClientInfo& client, size_t& space);
+    // `bytes` were written into the receive buffer; handles every complete line or frame.
+    void onReceived(ClientInfo& client, size_t bytes);
+    // The kernel took `bytes` of the client's output.
+    void onSent(ClientInfo& client, size_t bytes);
+    // Output made progress outside of a reply: drops failed clients, resumes paused ones.
+    void onWritable(ClientInfo& client);
+    void handleUdpData(int fd);
+    // The wakeup eventfd fired: finishes the commands the workers completed.
+    void handleWakeup();
+    // The signalfd is readable: a SIGINT or SIGTERM stops the server.
+    void handleSignal();
+    void removeClient(ClientInfo& client);
+
+    // Called on a worker thread when an offloaded command is done; takes ownership.
+    void completeCommand(OffloadedCommand* command);
+
+    // Subscribes the client or UDP peer of `context`, a command running on this thread.
+    ChannelTable::Result subscribe(const CommandContext& context, std::string_view channel);
+    // Leaves `channel`, or every channel if it is empty; returns how many were left.
+    size_t unsubscribe(const CommandContext& context, std::string_view channel);
+    // Sends `message` to the subscribers of `channel` on every reactor, once the current
+    // event has been handled.
+    void publish(std::string_view channel, std::string_view message);
+    // Any thread: queues a publication for this reactor's subscribers.
+    void deliver(const std::shared_ptr<const Publication>& publication);
+    // Any thread; a publication may skip a reactor without subscriptions.
+    bool hasSubscribers() const { return _subscriber_count.load(std::memory_order_relaxed) > 0; }
+
+private:
+    // Bound sockets for `endpoint`, which is updated if the IPv6 wildcard fell back to IPv4.
+    int createTcpSocket(Endpoint& endpoint);
+    int createUdpSocket(Endpoint& endpoint);
+    bool setReusePort(int fd);
+
+    // Outcome of the rate limits for one message.
+    enum class Admission
+    {
+        Run,
+        Skip,       // dropped or rejected
+        Wait        // left in the input; reading resumes once tokens are back
+    };
+
+    // Index of the command a message runs if that command has a rate limit, else -1.
+    int limitedCommand(std::string_view line) const;
+    int limitedCommand(const FrameHeader& frame, std::string_view payload) const;
+    // 0 if the sender's bucket and the command's (`command` >= 0) both have a token, which
+    // are then spent; else the milliseconds until they will, counted in `limited` or as a
+    // limited command.
+    uint64_t throttle(TokenBucket& sender, const RateLimit& limit, ShardCounter& limited, int command);
+    Admission admit(ClientInfo& client, int command, const FrameHeader* frame);
+    bool admitDatagram(UdpPeer& peer, int command, const FrameHeader* frame,
+                       sockaddr_storage* udp_addr, socklen_t udp_addr_len);
+    void rejectMessage(ClientInfo* client, const FrameHeader* frame,
+                       sockaddr_storage* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+
+    void processInput(ClientInfo& client);
+    // Handles complete frames until output reaches `high_water`; false if one is too long.
+    bool processFrames(ClientInfo& client, size_t high_water);
+    void echoLine(ClientInfo& client, std::string_view line);
+    void echoFrame(ClientInfo& client, const FrameHeader& request, std::string_view payload);
+    void expireUdpPeers();
+    // Keeps the expiry timer armed while there are UDP peers, and only then.
+    void armUdpExpiry();
+    // wait() for --low-latency: polls without sleeping for up to the busy-poll budget, so an
+    // event arriving meanwhile skips the sleep and wakeup, then blocks as usual.
+    bool busyWait(int timeout_ms);
+    // SO_BUSY_POLL and SO_PREFER_BUSY_POLL, for --low-latency.
+    void setBusyPoll(int fd);
+    void beginDrain();
+    // Half-closes the connections that have nothing left to send or wait for; they close
+    // once the peer does.
+    void closeDrained();
+
+    uint64_t nextDeadline(const ClientInfo& client) const;
+    void armDeadline(ClientInfo& client);
+    // Brings the deadline timer forward if a read, write or idle deadline now comes first.
+    void updateDeadline(ClientInfo& client);
+    void checkDeadlines(uint64_t token);
+    void processClientMessage(ClientInfo* client, std::string_view message,
+                              sockaddr_storage* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+    // Hands command `index` to the worker pool if it is marked for that; false to run it here.
+    bool offloadCommand(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len,
+                        int index, std::string_view args);
+    void finishCommand(OffloadedCommand& command);
+    void processFrame(ClientInfo* client, const FrameHeader& frame, std::string_view payload,
+                      sockaddr_storage* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+    // Runs a command through `execute`, which returns the command's index or -1, and times it.
+    template <typename Execute>
+    void runCommand(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len, Execute&& execute);
+
+    // Bytes a subscriber receives for `publication`, written once into the publication chunk.
+    struct EncodedMessage
+    {
+        ChunkRef chunk;
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+    void encodePublication(const Publication& publication, bool framed, EncodedMessage& encoded);
+    void fanOut(const Publication& publication);
+    // Drops the stale entries of channel `id` once they outnumber the live ones.
+    void sweepChannel(uint32_t id);
+    bool liveSubscriber(uint32_t id, const ChannelTable::TcpSubscriber& subscriber);
+    bool liveSubscriber(uint32_t id, const ChannelTable::UdpSubscriber& subscriber) const;
+    void subscriptionsChanged();
+
+    void closeAll();
+    void beginReply(ClientInfo& client);
+    void endReply(ClientInfo& client);
+    void flushReplies(ClientInfo& client);
+    void sendResponse(ClientInfo* client, std::string_view response,
+                      sockaddr_storage* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+    // Frames whatever `write` appends to a ReplyWriter as one reply on the client's transport:
+    // a line, or a binary frame while `_current_frame` is set.
+    template <typename Write>
+    void writeResponse(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len, Write&& write);
+
+private:
+    NetworkServer& _server;
+    const ServerConfig& _config;
+    int _id;
+    int _cpu;                   // pinned to it while running, or -1
+
+    // Declared first so chunks referenced by the backend, timers or clients go back to it
+    // before it is destroyed.
+    BufferPool _pool;
+
+    std::vector<int> _tcp_sockets;      // one listener per --listen endpoint
+    std::vector<int> _udp_sockets;
+    std::unique_ptr<IoBackend> _io;
+
+    // Written by workers to wake the loop when _completions goes from empty to non-empty.
+    // Closed only by the destructor, after the worker pool has stopped.
+    int _wake_fd = -1;
+    CompletionQueue _completions;
+    int _signal_fd = -1;        // owned by the server
+
+    bool _draining = false;
+    bool _drain_expired = false;
+
+    UdpBatch _udp_batch;
+    LoopClock _clock;           // read once per backend wakeup
+    TimerWheel _timers;
+    TimerId _udp_expiry_timer = 0;
+
+    ConnectionTable _connections;
+    UdpPeerTable _udp_peers;
+    size_t _max_connections;    // this reactor's share of --max-connections, 0: unlimited
+    UdpPeer* _current_udp_peer = nullptr;     // peer whose datagram is being processed
+    int _current_udp_socket = -1;             // socket it arrived on
+    FrameHeader* _current_frame = nullptr;    // reply header of the frame being processed
+
+    struct CommandLimit
+    {
+        RateLimit limit;        // this reactor's share of the command's rate
+        TokenBucket bucket;
+    };
+    bool _rate_limited = false;                 // any of the limits below is set
+    RateAction _rate_action = RateAction::Delay;
+    RateLimit _client_limit;
+    RateLimit _udp_limit;
+    std::vector<CommandLimit> _command_limits;  // by command index; empty if none is limited
+
+    ChannelTable _channels;
+    MpscQueue<PublicationDelivery> _publications;   // pushed by any reactor, drained on wakeup
+    MpscQueue<AdoptedClient> _adopted;              // pushed by the TLS acceptor
+    std::atomic<size_t> _subscriber_count{ 0 };     // _channels.subscriptions(), for publishers
+    SlowSubscriber _slow_subscriber = SlowSubscriber::Drop;
+    // Encoded publications are appended here and queued to subscribers by reference; the
+    // chunk starts over once no subscriber holds any of it.
+    ChunkRef _publish_chunk;
+    size_t _publish_used = 0;
+
+    MetricsShard _metrics;
+
+    static constexpr uint64_t UDP_EXPIRY_INTERVAL_MS = 1000;
+};
+
+bool setNonBlocking(int fd);
+
+#endif // REACTOR_HPP
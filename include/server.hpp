@@ -1,72 +1,106 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
-#include <unordered_map>
-#include <unordered_set>
 #include <memory>
 #include <atomic>
 #include <vector>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include "client.hpp"
+#include <string>
+#include <chrono>
+#include "config.hpp"
+#include "reactor.hpp"
+#include "command_registry.hpp"
+#include "metrics.hpp"
+#include "metrics_http.hpp"
+#include "worker_pool.hpp"
+#include "kv_store.hpp"
+#include "tls_acceptor.hpp"
 
-struct ServerStats 
+// Totals over all reactors, added up from their metric shards without locks.
+struct ServerStats
 {
-    uint64_t total_connections;
-    uint64_t current_connections;
-    uint64_t total_messages;
-    uint64_t total_commands;
-    std::chrono::seconds uptime;
+    uint64_t total_connections = 0;     // TCP connections accepted plus UDP peers seen
+    uint64_t current_connections = 0;
+    uint64_t rejected_connections = 0;
+    uint64_t udp_clients = 0;
+    uint64_t udp_expired = 0;
+    uint64_t udp_evicted = 0;
+    uint64_t total_messages = 0;
+    uint64_t total_commands = 0;
+    uint64_t bytes_received = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t tcp_responses = 0;
+    uint64_t tcp_writes = 0;
+    uint64_t limited_tcp = 0;
+    uint64_t limited_udp = 0;
+    uint64_t limited_commands = 0;
+    uint64_t subscriptions = 0;
+    uint64_t pubsub_delivered = 0;
+    uint64_t pubsub_dropped = 0;
+    uint64_t spin_ns = 0;
+    uint64_t sleep_ns = 0;
+    uint64_t spin_hits = 0;
+    KvStats kv;
+    uint64_t tls_handshakes = 0;
+    uint64_t tls_resumed = 0;
+    uint64_t tls_failed = 0;
+    HistogramSnapshot loop_events;
+    HistogramSnapshot queue_depth;
+    HistogramSnapshot command_ns;       // all commands together
+    std::chrono::seconds uptime{ 0 };
 };
 
-class NetworkServer 
+class NetworkServer
 {
 public:
-    NetworkServer(int tcp_port = 8080, int udp_port = 8081);
+    explicit NetworkServer(const ServerConfig& config = ServerConfig{});
     ~NetworkServer();
 
     bool initialize();
     void run();
+    // Any thread. The reactors stop accepting and drain their connections.
     void shutdown();
 
-private:
-    int createTcpSocket();
-    int createUdpSocket();
-    bool setupEpoll();
+    bool isRunning() const { return _running.load(std::memory_order_relaxed); }
 
-    void handleTcpConnection();
-    void handleTcpData(int client_fd);
-    void handleUdpData();
-    void processClientMessage(int client_fd, const std::string& message, bool is_udp = false,
-                            struct sockaddr_in* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+    // Adds a slash command; call before run(). Returns false if the name is taken.
+    bool registerCommand(std::string_view name, const CommandSpec& spec, CommandHandler handler);
+    // Adds a slow command that runs on the worker pool.
+    bool registerOffloadedCommand(std::string_view name, const CommandSpec& spec, OffloadedHandler handler);
+    const CommandRegistry& commands() const { return _commands; }
+    // Runs commands registered with registerOffloadedCommand(); nullptr if --workers is 0.
+    WorkerPool* workers() { return _workers.get(); }
+    // Any reactor thread: hands `publication` to every reactor that has subscribers.
+    void publish(const std::shared_ptr<const Publication>& publication);
 
-    std::string processCommand(const std::string& command);
-    std::string getCurrentTime();
-    std::string getStats();
+    ServerStats collectStats() const;
+    // Appends all metrics in the Prometheus text format.
+    void writeMetrics(std::string& out) const;
 
-    void removeClient(int client_fd);
-    bool setNonBlocking(int fd);
-    void sendResponse(int client_fd, const std::string& response, bool is_udp = false,
-                     struct sockaddr_in* udp_addr = nullptr, socklen_t udp_addr_len = 0);
+private:
+    void registerBuiltinCommands();
+    void writeStats(ReplyWriter& reply);
+    // Starts the sampled expiry of store keys on `reactor` unless it already runs somewhere.
+    void startKvExpiry(Reactor& reactor);
 
 private:
-    int _tcp_port;
-    int _udp_port;
-    
-    int _tcp_socket;
-    int _udp_socket;
-    int _epoll_fd;
-    
-    std::unordered_map<int, std::unique_ptr<ClientInfo>> _clients;
-    std::unordered_set<std::string> _udp_clients; 
-    
-    std::atomic<uint64_t> _total_connections;
-    std::atomic<uint64_t> _current_connections;
+    ServerConfig _config;
+    std::vector<std::unique_ptr<Reactor>> _reactors;
+    CommandRegistry _commands;
+    // Declared after the reactors and commands: destroyed first, so no task still runs
+    // or completes into a reactor that is gone.
+    std::unique_ptr<WorkerPool> _workers;
+    std::unique_ptr<MetricsHttpServer> _metrics_http;
+    std::unique_ptr<TlsAcceptor> _tls;      // hands connections to the reactors
+
+    KvStore _store;
+    // A timer on one reactor runs KvStore::expireSample() while keys have a TTL.
+    std::atomic<bool> _kv_expiry_running{ false };
+
+    // SIGINT and SIGTERM are blocked in every thread and read from here by reactor 0.
+    int _signal_fd = -1;
+
     std::chrono::system_clock::time_point _start_time;
-    
     std::atomic<bool> _running;
-    static constexpr int MAX_EVENTS = 64;
-    static constexpr int BUFFER_SIZE = 4096;
 };
 
-#endif // SERVER_HPP
\ No newline at end of file
+#endif // SERVER_HPP
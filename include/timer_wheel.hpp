@@ -0,0 +1,76 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <vector>
+#include <array>
+#include <functional>
+#include <cstdint>
+
+// Identifies a scheduled timer; stays safe to cancel after the timer has fired.
+// 0 is never a valid id.
+using TimerId = uint64_t;
+
+// Hierarchical timing wheel with 1 ms ticks, driven by the owning event loop.
+//
+// Four levels of 64 slots cover ~4.6 hours; later deadlines are parked in the last level
+// and cascaded again. Scheduling and cancelling are O(1): timers are intrusive list nodes
+// in a pooled array. Nothing here is thread-safe; every call comes from the loop thread.
+class TimerWheel
+{
+public:
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(uint64_t now_ms);
+
+    TimerId schedule(uint64_t delay_ms, Callback callback);
+    TimerId schedulePeriodic(uint64_t interval_ms, Callback callback);
+    void cancel(TimerId id);
+
+    // Fires every timer whose deadline is at or before `now_ms`.
+    void advance(uint64_t now_ms);
+
+    // Milliseconds until the wheel next needs advance(), or -1 if nothing is scheduled.
+    int timeoutMs(uint64_t now_ms) const;
+
+    size_t size() const { return _active; }
+
+private:
+    struct Node
+    {
+        uint64_t expires = 0;
+        uint64_t interval = 0;
+        Callback callback;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t generation = 1;    // never 0, so a zero TimerId means "no timer"
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool linked = false;
+    };
+
+    TimerId add(uint64_t delay_ms, uint64_t interval_ms, Callback callback);
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void cascade(int level);
+    void runSlot(uint8_t slot);
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_DELAY = (uint64_t{ 1 } << (SLOT_BITS * LEVELS)) - 1;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _free;
+    std::array<std::array<uint32_t, SLOTS>, LEVELS> _heads;
+    std::array<uint64_t, LEVELS> _occupied{};   // bit per non-empty slot
+    uint64_t _current;                          // next tick to process
+    uint64_t _now;                              // time passed to the last advance()
+    size_t _active = 0;
+    bool _firing = false;
+};
+
+#endif // TIMER_WHEEL_HPP
@@ -0,0 +1,94 @@
+#ifndef TLS_ACCEPTOR_HPP
+#define TLS_ACCEPTOR_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include "config.hpp"
+#include "timer_wheel.hpp"
+
+class Reactor;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+// TLS listener whose connections carry no userspace encryption once they are up.
+//
+// It runs on its own thread: accepts on --tls-port, does the handshake with OpenSSL on
+// non-blocking sockets and lets OpenSSL install the session keys in the kernel (kTLS,
+// TLS_TX and TLS_RX). The socket is then handed to a reactor like any accepted connection,
+// and its plain recv/sendmsg carry TLS records from there on. Handshakes never cost the
+// reactors CPU time. Sessions are resumed from the server cache or from tickets.
+//
+// Only built with `make TLS=1`.
+class TlsAcceptor
+{
+public:
+    TlsAcceptor(const ServerConfig& config, const std::vector<std::unique_ptr<Reactor>>& reactors);
+    ~TlsAcceptor();
+
+    TlsAcceptor(const TlsAcceptor&) = delete;
+    TlsAcceptor& operator=(const TlsAcceptor&) = delete;
+
+    // Loads the certificate and key, checks the kernel for kTLS and binds [::]:--tls-port.
+    bool listen();
+    void start();
+    // Any thread: makes the thread exit; handshakes in progress are dropped.
+    void stop();
+    // Waits for the thread, which exits once stop() is called.
+    void join();
+
+    // Any thread.
+    uint64_t handshakes() const { return _handshakes.load(std::memory_order_relaxed); }
+    uint64_t resumed() const { return _resumed.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return _failed.load(std::memory_order_relaxed); }
+
+private:
+    struct Handshake
+    {
+        SSL* ssl = nullptr;
+        sockaddr_storage addr;
+        socklen_t addr_len = 0;
+        TimerId timeout = 0;
+    };
+
+    // True if the kernel accepts the "tls" upper-layer protocol on a TCP socket.
+    static bool kernelTlsAvailable();
+    bool createContext();
+
+    void run();
+    void acceptAll();
+    // Moves the handshake on `fd` forward; done, failed or waiting for the socket.
+    void advance(int fd);
+    // The handshake on `fd` is done: hands it to a reactor if the kernel has its keys.
+    void finish(int fd, Handshake& handshake);
+    void drop(int fd);
+
+private:
+    const ServerConfig& _config;
+    const std::vector<std::unique_ptr<Reactor>>& _reactors;
+    SSL_CTX* _context = nullptr;
+
+    int _listener = -1;
+    int _epoll_fd = -1;
+    int _stop_fd = -1;      // eventfd written by stop()
+    std::thread _thread;
+
+    std::unordered_map<int, Handshake> _pending;    // handshakes in progress, by fd
+    TimerWheel _timers;
+    size_t _next_reactor = 0;
+
+    std::atomic<uint64_t> _handshakes{ 0 };
+    std::atomic<uint64_t> _resumed{ 0 };
+    std::atomic<uint64_t> _failed{ 0 };
+
+    static constexpr uint64_t HANDSHAKE_TIMEOUT_MS = 10000;
+    static constexpr long SESSION_CACHE_SIZE = 20000;
+    static constexpr int MAX_EVENTS = 64;
+};
+
+#endif // TLS_ACCEPTOR_HPP
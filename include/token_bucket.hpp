@@ -0,0 +1,61 @@
+#ifndef TOKEN_BUCKET_HPP
+#define TOKEN_BUCKET_HPP
+
+#include <algorithm>
+#include <string>
+#include <cstdint>
+
+// Messages per second, and how many may come at once before the rate applies.
+struct RateLimit
+{
+    uint32_t rate = 0;      // 0: unlimited
+    uint32_t burst = 0;
+};
+
+// What happens to a message over its limit.
+enum class RateAction : uint8_t
+{
+    Drop,       // ignored without a reply
+    Delay,      // TCP: left unread until tokens are back; UDP: dropped
+    Reject      // answered with an error
+};
+
+inline bool parseRateAction(const std::string& name, RateAction& action)
+{
+    if (name == "drop") action = RateAction::Drop;
+    else if (name == "delay") action = RateAction::Delay;
+    else if (name == "reject") action = RateAction::Reject;
+    else return false;
+    return true;
+}
+
+// Token bucket that refills lazily from the loop clock when it is checked, so it needs
+// no timer and fits inline in a connection or peer record.
+//
+// Tokens are counted in thousandths: `rate` per second is exactly `rate` thousandths
+// per millisecond, so refills need no division.
+struct TokenBucket
+{
+    static constexpr uint64_t TOKEN = 1000;
+
+    uint64_t tokens = 0;
+    uint64_t last_ms = 0;   // 0: never checked; the bucket starts full
+
+    // Adds the tokens earned since the last check; `limit.rate` must not be 0. Returns 0
+    // if a token is available, else the milliseconds until one will be.
+    uint64_t refill(uint64_t now_ms, const RateLimit& limit)
+    {
+        uint64_t capacity = static_cast<uint64_t>(std::max(limit.burst, 1u)) * TOKEN;
+        tokens = last_ms == 0 ? capacity : std::min(capacity, tokens + (now_ms - last_ms) * limit.rate);
+        last_ms = now_ms;
+
+        if (tokens >= TOKEN)
+            return 0;
+        return (TOKEN - tokens + limit.rate - 1) / limit.rate;
+    }
+
+    // Spends the token refill() found.
+    void take() { tokens -= TOKEN; }
+};
+
+#endif // TOKEN_BUCKET_HPP
@@ -0,0 +1,91 @@
+#ifndef UDP_BATCH_HPP
+#define UDP_BATCH_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// Batched UDP I/O for one reactor.
+//
+// receive() drains up to `batch_size` datagrams with a single recvmmsg(); replies queued
+// with queueReply() are sent together by flush() with a single sendmmsg(). Consecutive
+// replies to the same peer are coalesced into one UDP_SEGMENT (GSO) send when the kernel
+// supports it. On kernels without recvmmsg/sendmmsg or GSO the same calls fall back to
+// recvfrom()/sendto() and plain datagrams.
+class UdpBatch
+{
+public:
+    explicit UdpBatch(size_t batch_size);
+
+    // Detects GSO support on the bound socket.
+    void probe(int fd);
+
+    // Returns the number of datagrams received, 0 if none are pending, -1 on error.
+    int receive(int fd);
+
+    std::string_view payload(int i) const;
+    sockaddr_storage* peer(int i) { return &_peers[i]; }
+    socklen_t peerLength(int i) const { return _recv_msgs[i].msg_hdr.msg_namelen; }
+
+    size_t batchSize() const { return _batch_size; }
+    bool gsoEnabled() const { return _gso_enabled; }
+
+    // Queues `data` plus a trailing newline as one datagram to `addr`.
+    void queueReply(const sockaddr_storage& addr, socklen_t addr_len, std::string_view data);
+    // In-place variant: append the payload to replyBuffer(), then commit it with the size
+    // replyBuffer() had before. The newline is added here as well unless `newline` is false.
+    std::string& replyBuffer() { return _out; }
+    void commitReply(const sockaddr_storage& addr, socklen_t addr_len, size_t offset, bool newline = true);
+    // Queues another datagram carrying `size` bytes already in replyBuffer() at `offset`,
+    // e.g. one message going to many peers.
+    void queueRepeat(const sockaddr_storage& addr, socklen_t addr_len, size_t offset, size_t size);
+    size_t queued() const { return _replies.size(); }
+    void flush(int fd);
+
+private:
+    struct Reply
+    {
+        sockaddr_storage addr;
+        socklen_t addr_len;
+        size_t offset;
+        size_t size;
+    };
+
+    union SegmentControl
+    {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        cmsghdr align;
+    };
+
+    int receiveEach(int fd);
+    void buildMessages(size_t first_reply);
+    void sendEach(int fd, size_t first_reply);
+    bool sameDestination(const Reply& a, const Reply& b) const;
+
+private:
+    size_t _batch_size;
+    bool _mmsg_supported = true;
+    bool _gso_enabled = false;
+
+    std::vector<char> _recv_storage;
+    std::vector<sockaddr_storage> _peers;
+    std::vector<iovec> _recv_iov;
+    std::vector<mmsghdr> _recv_msgs;
+
+    std::string _out;
+    std::vector<Reply> _replies;
+    std::vector<iovec> _send_iov;
+    std::vector<mmsghdr> _send_msgs;
+    std::vector<SegmentControl> _send_control;
+    std::vector<size_t> _send_first;    // index of the first reply carried by each message
+
+    static constexpr size_t DATAGRAM_SIZE = 4096;
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;
+    static constexpr size_t MAX_GSO_BYTES = 65000;
+};
+
+#endif // UDP_BATCH_HPP
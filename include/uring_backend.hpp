@@ -0,0 +1,174 @@
+#ifndef URING_BACKEND_HPP
+#define URING_BACKEND_HPP
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include "io_backend.hpp"
+#include "buffer.hpp"
+
+// Completion-based backend on io_uring, driven through the raw syscalls.
+//
+// Every listener keeps --accept-batch single-shot accepts in flight, each with its own
+// address buffer, so a loop iteration takes at most that many connections per listener
+// and learns their peers without a syscall. Every UDP socket runs one multishot poll, which
+// hands datagrams to the reactor's recvmmsg() batching; another multishot poll watches
+// the reactor's wakeup eventfd, and the server's signalfd where there is one. Each connection has one multishot
+// recv that picks buffers from a ring registered with the kernel, and at most one sendmsg
+// in flight, which takes the whole output queue as scatter-gather. Requests queued while dispatching go to the kernel together with the next wait,
+// so a loop iteration costs one io_uring_enter() however many clients it served.
+class UringBackend : public IoBackend
+{
+public:
+    explicit UringBackend(Reactor& reactor);
+    ~UringBackend() override;
+
+    // Creates the rings and the buffer ring; false if this kernel can't run the backend.
+    bool setup();
+
+    const char* name() const override { return "io_uring"; }
+
+    bool start(const std::vector<int>& tcp_sockets, const std::vector<int>& udp_sockets,
+               int wake_fd, int signal_fd) override;
+    void stopListening() override;
+
+    bool addClient(ClientInfo& client) override;
+    void removeClient(ClientInfo& client) override;
+    void resumeRead(ClientInfo& client) override;
+    void flush(ClientInfo& client) override;
+    size_t pendingOutput(const ClientInfo& client) const override;
+
+    bool wait(int timeout_ms) override;
+    bool ready() const override { return __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE) != *_cq_head; }
+    size_t dispatch() override;
+
+private:
+    // Operation kind in the top byte of user_data; the rest is the connection token, the
+    // index in _accepts for accepts, or the fd for UDP polls.
+    enum Op : uint64_t
+    {
+        OP_ACCEPT = 1,
+        OP_UDP_POLL,
+        OP_RECV,
+        OP_SEND,
+        OP_CANCEL,
+        OP_WAKE_POLL,
+        OP_SIGNAL_POLL
+    };
+
+    static constexpr uint64_t TOKEN_MASK = (uint64_t{ 1 } << 56) - 1;
+    static uint64_t tag(Op op, uint64_t token) { return (static_cast<uint64_t>(op) << 56) | token; }
+
+    // Received bytes the reactor could not take yet because reading is paused.
+    struct Parked
+    {
+        uint16_t bid;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Output handed to the in-flight sendmsg, with the message that describes it.
+    struct Outgoing
+    {
+        OutputBuffer data;
+        msghdr msg{};
+        std::array<iovec, 64> iov;
+    };
+
+    // One accept in flight, with the peer address the kernel fills in.
+    struct AcceptSlot
+    {
+        int listener = -1;
+        bool armed = false;
+        socklen_t addr_len = 0;
+        sockaddr_storage addr{};
+    };
+
+    struct Connection
+    {
+        // Heap-allocated so the kernel's pointers stay valid when the table grows.
+        std::unique_ptr<Outgoing> sending;
+        bool send_active = false;
+        bool recv_active = false;   // the recv is still armed
+        bool recv_cancelling = false;
+        bool recv_starved = false;  // the recv ran out of buffers and waits in _starved
+        std::deque<Parked> parked;
+    };
+
+    io_uring_sqe* nextSqe();
+    bool enter(unsigned min_complete, unsigned flags, int timeout_ms);
+    void armAccept(size_t slot);
+    void armUdpPoll(int fd);
+    void armWakePoll();
+    void armSignalPoll();
+    void armRecv(ClientInfo& client);
+    void submitSend(ClientInfo& client, Outgoing& out);
+    void cancel(uint64_t user_data);
+
+    void handleAccept(const io_uring_cqe& cqe);
+    void handleRecv(const io_uring_cqe& cqe);
+    void handleSend(const io_uring_cqe& cqe);
+    size_t deliver(ClientInfo& client, const char* data, size_t length);
+    char* bufferData(uint16_t bid) { return _buffers + static_cast<size_t>(bid) * BUFFER_SIZE; }
+    // Returns the buffer to the ring and re-arms the recv of a connection that ran out.
+    void recycleBuffer(uint16_t bid);
+
+    Connection& connection(const ClientInfo& client);
+
+private:
+    Reactor& _reactor;
+    int _ring_fd = -1;
+    int _wake_fd = -1;
+    int _signal_fd = -1;
+    std::vector<int> _listeners;    // empty once listening stopped
+    // Sized once in start(): the kernel writes into the slots while their accepts are armed.
+    std::vector<AcceptSlot> _accepts;
+    size_t _accepts_waiting = 0;    // slots backing off after EMFILE and the like
+    bool _multishot_recv = true;    // cleared when the kernel refuses IORING_RECV_MULTISHOT
+
+    // Submission and completion rings, mapped from the kernel
+    void* _sq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    void* _cq_ring = nullptr;
+    size_t _cq_ring_size = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    unsigned* _sq_head = nullptr;
+    unsigned* _sq_tail = nullptr;
+    unsigned _sq_mask = 0;
+    unsigned _sq_entries = 0;
+    unsigned _sq_local_tail = 0;    // SQEs filled in, published to the kernel on enter()
+
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned _cq_mask = 0;
+    io_uring_cqe* _cqes = nullptr;
+
+    // Provided buffers for multishot recv
+    io_uring_buf_ring* _buf_ring = nullptr;
+    size_t _buf_ring_size = 0;
+    char* _buffers = nullptr;
+    uint16_t _buf_tail = 0;
+    // Tokens of connections whose recv failed with ENOBUFS, oldest first. Paused clients
+    // can hold every buffer for a while; these wait for one to come back instead of
+    // re-arming into the same error.
+    std::deque<uint64_t> _starved;
+
+    std::vector<Connection> _connections;   // indexed by ClientInfo::slot
+    // Sends of closed connections, kept until the kernel reports it is done with them.
+    std::vector<std::pair<uint64_t, std::unique_ptr<Outgoing>>> _orphans;
+
+    static constexpr unsigned RING_ENTRIES = 4096;
+    static constexpr unsigned BUFFER_COUNT = 1024;  // power of two
+    static constexpr size_t BUFFER_SIZE = 4096;
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    // Pause before accepting again once the process is out of descriptors or memory.
+    static constexpr uint64_t ACCEPT_RETRY_MS = 100;
+};
+
+#endif // URING_BACKEND_HPP
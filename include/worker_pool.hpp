@@ -0,0 +1,57 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// Work-stealing thread pool for commands too slow to run on a reactor thread.
+//
+// Every worker has its own queue. Submitted tasks are dealt to the queues in turn; a
+// worker takes from the front of its own queue and, when that is empty, steals from the
+// back of the others', so one long task never holds up the ones queued behind it while
+// another worker is idle. Idle workers sleep until something is submitted.
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(size_t threads);
+    // Runs the tasks still queued, then joins the workers.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Safe to call from any thread.
+    void submit(Task task);
+    size_t size() const { return _threads.size(); }
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(size_t self);
+    bool take(size_t self, Task& task);
+
+private:
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+
+    std::atomic<size_t> _queued{ 0 };   // tasks in all queues
+    std::atomic<size_t> _next{ 0 };     // queue for the next submit
+    std::mutex _sleep_mutex;
+    std::condition_variable _wakeup;
+    bool _stopping = false;             // guarded by _sleep_mutex
+};
+
+#endif // WORKER_POOL_HPP
@@ -0,0 +1,234 @@
+#include "../include/buffer.hpp"
+#include <cstring>
+#include <algorithm>
+
+bool InputBuffer::prepareWrite(BufferPool& pool, size_t limit)
+{
+    // Slices queued for sending may still point at the consumed bytes of a shared chunk.
+    if (_head == _tail && !_chunk.shared())
+    {
+        _head = _scan = _tail = 0;
+    }
+
+    size_t pending = _tail - _head;
+    if (pending > limit)
+        return false;   // the partial line alone is longer than a line may be
+
+    // Room for the rest of a maximal line, but ask for no more than a useful recv().
+    size_t useful = limit + 1 - pending;
+    size_t wanted = std::min(useful, MIN_READ);
+    size_t capacity = _chunk.capacity();
+
+    if (capacity - _tail < wanted)
+    {
+        if (_chunk && !_chunk.shared() && capacity - pending >= std::max(wanted, capacity / 4))
+        {
+            compact();
+        }
+        else
+        {
+            // Move the partial line to a new chunk, growing geometrically for long lines.
+            size_t new_capacity = pool.chunkSize();
+            if (pending + wanted > new_capacity)
+            {
+                new_capacity = std::min(std::max(capacity * 2, pending + wanted), limit + 1);
+            }
+
+            ChunkRef fresh = pool.acquire(new_capacity);
+            if (pending > 0)
+            {
+                std::memcpy(fresh.data(), _chunk.data() + _head, pending);
+            }
+            _chunk = std::move(fresh);
+            _scan -= _head;
+            _head = 0;
+            _tail = pending;
+            capacity = _chunk.capacity();
+        }
+    }
+
+    _end = _tail + std::min(capacity - _tail, useful);
+    return true;
+}
+
+bool InputBuffer::nextLine(std::string_view& line)
+{
+    if (_scan == _tail)
+        return false;
+
+    const char* base = _chunk.data();
+    const void* nl = std::memchr(base + _scan, '\n', _tail - _scan);
+    if (!nl)
+    {
+        _scan = _tail;
+        return false;
+    }
+
+    size_t pos = static_cast<const char*>(nl) - base;
+    line = std::string_view(base + _head, pos - _head);
+    _head = _scan = pos + 1;
+    return true;
+}
+
+void InputBuffer::release()
+{
+    _chunk.reset();
+    _head = _scan = _tail = _end = 0;
+}
+
+void InputBuffer::compact()
+{
+    size_t len = _tail - _head;
+    std::memmove(_chunk.data(), _chunk.data() + _head, len);
+    _scan -= _head;
+    _head = 0;
+    _tail = len;
+}
+
+void OutputBuffer::appendShared(const ChunkRef& chunk, const char* data, size_t length)
+{
+    if (length == 0)
+        return;
+
+    std::deque<Segment>& segments = this->segments();
+    if (!segments.empty())
+    {
+        Segment& last = segments.back();
+        if (!last.chunk)
+        {
+            _size += last.bytes.size();     // sealed: nothing is appended to it any more
+        }
+        else if (last.chunk.get() == chunk.get() && last.data + last.length == data)
+        {
+            last.length += length;
+            _size += length;
+            return;
+        }
+    }
+
+    Segment& segment = segments.emplace_back();
+    segment.chunk = chunk;
+    segment.data = data;
+    segment.length = length;
+    _size += length;
+}
+
+std::string& OutputBuffer::appendTarget()
+{
+    std::deque<Segment>& segments = this->segments();
+    if (segments.empty() || segments.back().chunk)
+    {
+        Segment& segment = segments.emplace_back();
+        segment.bytes.swap(_spare);
+    }
+
+    return segments.back().bytes;
+}
+
+std::deque<OutputBuffer::Segment>& OutputBuffer::segments()
+{
+    if (!_segments)
+    {
+        _segments = std::make_unique<std::deque<Segment>>();
+    }
+    return *_segments;
+}
+
+size_t OutputBuffer::gather(iovec* iov, size_t max, size_t split) const
+{
+    size_t count = 0;
+    size_t offset = _head;
+    if (!_segments)
+        return 0;
+
+    for (const Segment& segment : *_segments)
+    {
+        if (count == max)
+            break;
+
+        size_t length = segment.size() - offset;
+        if (length == 0)
+            continue;   // an open owned segment that hasn't been written to yet
+
+        if (split > 0 && segment.chunk && segment.length >= split)
+        {
+            if (count == 0)
+            {
+                iov[count++] = { const_cast<char*>(segment.begin()) + offset, length };
+            }
+            break;
+        }
+
+        iov[count++] = { const_cast<char*>(segment.begin()) + offset, length };
+        offset = 0;
+    }
+
+    return count;
+}
+
+const ChunkRef* OutputBuffer::frontChunk() const
+{
+    return _segments && !_segments->empty() && _segments->front().chunk ? &_segments->front().chunk : nullptr;
+}
+
+void OutputBuffer::consume(size_t n)
+{
+    _head += n;
+
+    while (_segments && !_segments->empty())
+    {
+        Segment& front = _segments->front();
+        size_t length = front.size();
+
+        if (_head >= length)
+        {
+            _head -= length;
+            popFront();
+            continue;
+        }
+
+        // Drop the sent prefix of owned bytes once it dominates, so a slow reader doesn't
+        // pin it forever.
+        if (!front.chunk && _head > length / 2)
+        {
+            front.bytes.erase(0, _head);
+            if (_segments->size() > 1)
+            {
+                _size -= _head;
+            }
+            _head = 0;
+        }
+        break;
+    }
+}
+
+void OutputBuffer::popFront()
+{
+    Segment& front = _segments->front();
+
+    if (front.chunk || _segments->size() > 1)
+    {
+        _size -= front.size();
+    }
+    if (!front.chunk && front.bytes.capacity() > _spare.capacity())
+    {
+        front.bytes.clear();
+        front.bytes.swap(_spare);
+    }
+
+    _segments->pop_front();
+}
+
+void OutputBuffer::takeInto(OutputBuffer& dst)
+{
+    _segments.swap(dst._segments);
+    std::swap(_size, dst._size);
+    std::swap(_head, dst._head);
+}
+
+void OutputBuffer::release()
+{
+    _segments.reset();
+    std::string().swap(_spare);
+    _size = _head = 0;
+}
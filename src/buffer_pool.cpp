@@ -0,0 +1,89 @@
+#include "../include/buffer_pool.hpp"
+#include <new>
+
+ChunkRef& ChunkRef::operator=(const ChunkRef& other)
+{
+    if (other._chunk)
+    {
+        ++other._chunk->refs;
+    }
+    reset();
+    _chunk = other._chunk;
+    return *this;
+}
+
+ChunkRef& ChunkRef::operator=(ChunkRef&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        _chunk = other._chunk;
+        other._chunk = nullptr;
+    }
+    return *this;
+}
+
+void ChunkRef::reset()
+{
+    if (_chunk && --_chunk->refs == 0)
+    {
+        _chunk->pool->recycle(_chunk);
+    }
+    _chunk = nullptr;
+}
+
+BufferPool::BufferPool(size_t chunk_size)
+    :   _chunk_size{ chunk_size },
+        _stride{ (sizeof(Chunk) + chunk_size + 63) & ~size_t{ 63 } }
+{
+}
+
+BufferPool::~BufferPool() = default;
+
+ChunkRef BufferPool::acquire(size_t min_capacity)
+{
+    if (min_capacity > _chunk_size)
+    {
+        void* memory = ::operator new(sizeof(Chunk) + min_capacity);
+        return ChunkRef(new (memory) Chunk{ this, nullptr, min_capacity, 0 });
+    }
+
+    if (!_free)
+    {
+        grow();
+    }
+
+    Chunk* chunk = _free;
+    _free = chunk->next_free;
+    --_available;
+    return ChunkRef(chunk);
+}
+
+void BufferPool::recycle(Chunk* chunk)
+{
+    if (chunk->capacity != _chunk_size)
+    {
+        chunk->~Chunk();
+        ::operator delete(chunk);
+        return;
+    }
+
+    chunk->next_free = _free;
+    _free = chunk;
+    ++_available;
+}
+
+void BufferPool::grow()
+{
+    std::unique_ptr<char[]> slab(new char[SLAB_CHUNKS * _stride]);
+
+    for (size_t i = SLAB_CHUNKS; i-- > 0;)
+    {
+        Chunk* chunk = new (slab.get() + i * _stride) Chunk{ this, _free, _chunk_size, 0 };
+        _free = chunk;
+    }
+
+    _slabs.push_back(std::move(slab));
+    _allocated += SLAB_CHUNKS;
+    _available += SLAB_CHUNKS;
+}
@@ -0,0 +1,46 @@
+#include "../include/client.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+void ClientInfo::open(int client_fd, const sockaddr_storage& addr, socklen_t addr_len,
+                      std::chrono::system_clock::time_point now)
+{
+    fd = client_fd;
+    // Generation 0 is reserved for listening sockets.
+    generation = (generation + 1) & GENERATION_MASK;
+    if (generation == 0)
+        generation = 1;
+    active = true;
+    want_write = false;
+    read_paused = false;
+    write_failed = false;
+    batching = false;
+    job_pending = false;
+    lingering = false;
+    ktls = false;
+    framing = Framing::Unknown;
+
+    std::memcpy(&address, &addr, addr_len);
+    address_len = addr_len;
+    connect_time = now;
+    bytes_received = 0;
+    bytes_sent = 0;
+
+    deadline_timer = 0;
+    deadline_ms = UINT64_MAX;
+    last_activity_ms = 0;
+    read_started_ms = 0;
+    write_started_ms = 0;
+
+    rate_bucket = TokenBucket{};
+    rate_timer = 0;
+}
+
+void ClientInfo::close()
+{
+    active = false;
+    input.release();
+    output.release();
+    subscriptions.clear();
+}
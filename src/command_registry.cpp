@@ -0,0 +1,223 @@
+#include "../include/command_registry.hpp"
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static std::string_view skipSpaces(std::string_view text)
+{
+    size_t i = 0;
+    while (i < text.size() && isSpace(text[i]))
+    {
+        ++i;
+    }
+    return text.substr(i);
+}
+
+bool CommandArgs::toInt(size_t i, int64_t& value) const
+{
+    if (i >= _count)
+        return false;
+
+    std::string_view text = _args[i];
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool CommandRegistry::add(std::string_view name, const CommandSpec& spec, CommandHandler handler)
+{
+    Entry entry;
+    entry.handler = std::move(handler);
+    return insert(name, spec, std::move(entry));
+}
+
+bool CommandRegistry::addOffloaded(std::string_view name, const CommandSpec& spec, OffloadedHandler handler)
+{
+    Entry entry;
+    entry.offloaded = std::move(handler);
+    return insert(name, spec, std::move(entry));
+}
+
+bool CommandRegistry::insert(std::string_view name, const CommandSpec& spec, Entry entry)
+{
+    if (name.empty() || contains(name) || spec.max_args > CommandArgs::MAX_ARGS || spec.min_args > spec.max_args)
+        return false;
+
+    entry.name = std::string(name);
+    entry.spec = spec;
+    entry.usage = spec.usage.empty() ? entry.name : std::string(spec.usage);
+    _entries.push_back(std::move(entry));
+
+    rebuild();
+    return true;
+}
+
+bool CommandRegistry::setRateLimit(std::string_view name, uint32_t rate)
+{
+    for (Entry& entry : _entries)
+    {
+        if (entry.name == name)
+        {
+            entry.spec.rate_limit = rate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t CommandRegistry::hash(std::string_view name, uint64_t seed)
+{
+    // FNV-1a with a seeded offset basis
+    uint64_t h = 0xcbf29ce484222325ull ^ seed;
+    for (char c : name)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h ^ (h >> 29);
+}
+
+void CommandRegistry::rebuild()
+{
+    size_t size = 8;
+    while (size < _entries.size() * 2)
+    {
+        size <<= 1;
+    }
+
+    // Search for a seed under which every name gets a slot of its own; grow the table if
+    // none turns up quickly. With a table at least twice the key count this ends fast.
+    for (;; size <<= 1)
+    {
+        for (uint64_t seed = 1; seed <= 256; ++seed)
+        {
+            std::vector<int32_t> slots(size, -1);
+            bool collision = false;
+            for (size_t i = 0; i < _entries.size() && !collision; ++i)
+            {
+                int32_t& slot = slots[hash(_entries[i].name, seed) & (size - 1)];
+                collision = slot != -1;
+                slot = static_cast<int32_t>(i);
+            }
+
+            if (!collision)
+            {
+                _slots = std::move(slots);
+                _seed = seed;
+                _mask = size - 1;
+                return;
+            }
+        }
+    }
+}
+
+const CommandRegistry::Entry* CommandRegistry::find(std::string_view name) const
+{
+    if (_slots.empty())
+        return nullptr;
+
+    int32_t index = _slots[hash(name, _seed) & _mask];
+    if (index < 0 || _entries[index].name != name)
+        return nullptr;
+    return &_entries[index];
+}
+
+bool CommandRegistry::parseArgs(std::string_view text, const CommandSpec& spec, CommandArgs& args)
+{
+    args._count = 0;
+    text = skipSpaces(text);
+
+    while (!text.empty())
+    {
+        if (args._count == spec.max_args)
+            return false;
+
+        if (spec.rest && args._count + 1 == spec.max_args)
+        {
+            args._args[args._count++] = text;
+            break;
+        }
+
+        size_t end = 0;
+        while (end < text.size() && !isSpace(text[end]))
+        {
+            ++end;
+        }
+        args._args[args._count++] = text.substr(0, end);
+        text = skipSpaces(text.substr(end));
+    }
+
+    return args._count >= spec.min_args;
+}
+
+int CommandRegistry::lookup(std::string_view line, std::string_view& args) const
+{
+    size_t end = 0;
+    while (end < line.size() && !isSpace(line[end]))
+    {
+        ++end;
+    }
+
+    const Entry* entry = find(line.substr(0, end));
+    if (!entry)
+        return -1;
+
+    args = line.substr(end);
+    return static_cast<int>(entry - _entries.data());
+}
+
+int CommandRegistry::execute(CommandContext& context, std::string_view line, ReplyWriter& reply) const
+{
+    std::string_view args;
+    int index = lookup(line, args);
+    if (index < 0)
+    {
+        reply << "Unknown command: " << line;
+        return -1;
+    }
+
+    return run(_entries[index], &context, args, reply);
+}
+
+int CommandRegistry::execute(CommandContext& context, size_t index, std::string_view args, ReplyWriter& reply) const
+{
+    if (index >= _entries.size())
+    {
+        reply << "Unknown command index: " << index;
+        return -1;
+    }
+
+    return run(_entries[index], &context, args, reply);
+}
+
+int CommandRegistry::executeOffloaded(size_t index, std::string_view args, ReplyWriter& reply) const
+{
+    if (index >= _entries.size() || !_entries[index].offloaded)
+    {
+        reply << "Unknown command index: " << index;
+        return -1;
+    }
+
+    return run(_entries[index], nullptr, args, reply);
+}
+
+int CommandRegistry::run(const Entry& entry, CommandContext* context, std::string_view text, ReplyWriter& reply) const
+{
+    CommandArgs args;
+    if (!parseArgs(text, entry.spec, args))
+    {
+        reply << "Usage: " << entry.usage;
+        return -1;
+    }
+
+    if (entry.offloaded)
+    {
+        entry.offloaded(args, reply);
+    }
+    else
+    {
+        entry.handler(*context, args, reply);
+    }
+    return static_cast<int>(&entry - _entries.data());
+}
@@ -0,0 +1,36 @@
+#include "../include/connection_table.hpp"
+
+ClientInfo& ConnectionTable::acquire(int fd, const sockaddr_storage& addr, socklen_t addr_len,
+                                     std::chrono::system_clock::time_point now)
+{
+    uint32_t slot;
+    if (!_free.empty())
+    {
+        slot = _free.back();
+        _free.pop_back();
+    }
+    else
+    {
+        slot = _slots++;
+        if ((slot >> PAGE_SHIFT) >= _pages.size())
+        {
+            _pages.emplace_back(new ClientInfo[PAGE_SIZE]);
+        }
+    }
+
+    ClientInfo& client = _pages[slot >> PAGE_SHIFT][slot & PAGE_MASK];
+    client.slot = slot;
+    client.open(fd, addr, addr_len, now);
+    ++_size;
+    return client;
+}
+
+void ConnectionTable::release(ClientInfo& client)
+{
+    if (!client.active)
+        return;
+
+    client.close();
+    _free.push_back(client.slot);
+    --_size;
+}
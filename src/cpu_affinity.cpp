@@ -0,0 +1,98 @@
+#include "../include/cpu_affinity.hpp"
+#include <charconv>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+namespace
+{
+
+bool parseCpu(std::string_view text, int& cpu)
+{
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+    return error == std::errc() && end == text.data() + text.size() && cpu >= 0 && cpu < CPU_SETSIZE;
+}
+
+} // namespace
+
+bool parseCpuList(std::string_view text, std::vector<int>& cpus)
+{
+    while (!text.empty())
+    {
+        size_t comma = text.find(',');
+        std::string_view item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+
+        size_t dash = item.find('-');
+        int first = 0;
+        int last = 0;
+        if (!parseCpu(item.substr(0, dash), first))
+            return false;
+        last = first;
+        if (dash != std::string_view::npos && (!parseCpu(item.substr(dash + 1), last) || last < first))
+            return false;
+
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+bool pinThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    errno = result;
+    return result == 0;
+}
+
+int cpuNode(int cpu)
+{
+    // The CPU's sysfs directory links to its node as "nodeN".
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return -1;
+
+    int node = -1;
+    while (dirent* entry = readdir(dir))
+    {
+        if (std::sscanf(entry->d_name, "node%d", &node) == 1)
+            break;
+        node = -1;
+    }
+    closedir(dir);
+    return node;
+}
+
+PreferredNode::PreferredNode(int node)
+{
+    if (node < 0)
+        return;
+
+    // No libnuma: the syscall takes a node bitmask and its size in bits.
+    unsigned long mask[16] = {};
+    constexpr unsigned long BITS = sizeof(mask) * 8;
+    if (static_cast<unsigned long>(node) >= BITS)
+        return;
+    mask[node / (sizeof(unsigned long) * 8)] = 1ul << (node % (sizeof(unsigned long) * 8));
+    _set = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, BITS) == 0;
+}
+
+PreferredNode::~PreferredNode()
+{
+    if (_set)
+    {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    }
+}
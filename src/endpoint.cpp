@@ -0,0 +1,154 @@
+#include "../include/endpoint.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+
+bool parseEndpoint(std::string_view text, Endpoint& endpoint)
+{
+    size_t colon = text.rfind(':');
+    if (colon == std::string_view::npos)
+        return false;
+
+    std::string_view host = text.substr(0, colon);
+    std::string_view port_text = text.substr(colon + 1);
+
+    int port = 0;
+    auto result = std::from_chars(port_text.data(), port_text.data() + port_text.size(), port);
+    if (result.ec != std::errc() || result.ptr != port_text.data() + port_text.size() || port < 1 || port > 65535)
+        return false;
+
+    if (host == "*")
+    {
+        endpoint = anyEndpoint(port);
+        return true;
+    }
+
+    endpoint = Endpoint{};
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+    {
+        std::string ip(host.substr(1, host.size() - 2));
+        auto& in6 = reinterpret_cast<sockaddr_in6&>(endpoint.addr);
+        if (inet_pton(AF_INET6, ip.c_str(), &in6.sin6_addr) != 1)
+            return false;
+        in6.sin6_family = AF_INET6;
+        in6.sin6_port = htons(static_cast<uint16_t>(port));
+        endpoint.addr_len = sizeof(sockaddr_in6);
+        return true;
+    }
+
+    std::string ip(host);
+    auto& in = reinterpret_cast<sockaddr_in&>(endpoint.addr);
+    if (inet_pton(AF_INET, ip.c_str(), &in.sin_addr) != 1)
+        return false;
+    in.sin_family = AF_INET;
+    in.sin_port = htons(static_cast<uint16_t>(port));
+    endpoint.addr_len = sizeof(sockaddr_in);
+    return true;
+}
+
+bool parseEndpointList(std::string_view text, std::vector<Endpoint>& endpoints)
+{
+    while (!text.empty())
+    {
+        size_t comma = text.find(',');
+        Endpoint endpoint;
+        if (!parseEndpoint(text.substr(0, comma), endpoint))
+            return false;
+        endpoints.push_back(endpoint);
+
+        if (comma == std::string_view::npos)
+            break;
+        text.remove_prefix(comma + 1);
+    }
+
+    return !endpoints.empty();
+}
+
+Endpoint anyEndpoint(int port)
+{
+    Endpoint endpoint;
+    auto& in6 = reinterpret_cast<sockaddr_in6&>(endpoint.addr);
+    in6.sin6_family = AF_INET6;
+    in6.sin6_addr = in6addr_any;
+    in6.sin6_port = htons(static_cast<uint16_t>(port));
+    endpoint.addr_len = sizeof(sockaddr_in6);
+    return endpoint;
+}
+
+std::vector<Endpoint> listenEndpoints(const std::vector<Endpoint>& configured, int default_port)
+{
+    if (!configured.empty())
+        return configured;
+    return { anyEndpoint(default_port) };
+}
+
+int openSocket(Endpoint& endpoint, int type)
+{
+    int sock = socket(endpoint.addr.ss_family, type, 0);
+    if (sock < 0 && errno == EAFNOSUPPORT && endpoint.addr.ss_family == AF_INET6)
+    {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(endpoint.addr);
+        if (!IN6_IS_ADDR_UNSPECIFIED(&in6.sin6_addr))
+            return -1;
+
+        uint16_t port = in6.sin6_port;
+        endpoint = Endpoint{};
+        auto& in = reinterpret_cast<sockaddr_in&>(endpoint.addr);
+        in.sin_family = AF_INET;
+        in.sin_addr.s_addr = INADDR_ANY;
+        in.sin_port = port;
+        endpoint.addr_len = sizeof(sockaddr_in);
+        sock = socket(AF_INET, type, 0);
+    }
+
+    if (sock < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    if (endpoint.addr.ss_family == AF_INET6)
+    {
+        int off = 0;
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) < 0)
+        {
+            perror("setsockopt IPV6_V6ONLY");
+        }
+    }
+
+    return sock;
+}
+
+std::string formatAddress(const sockaddr_storage& addr)
+{
+    char ip[INET6_ADDRSTRLEN] = "?";
+    uint16_t port = 0;
+    bool brackets = false;
+
+    if (addr.ss_family == AF_INET)
+    {
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+        inet_ntop(AF_INET, &in.sin_addr, ip, sizeof(ip));
+        port = ntohs(in.sin_port);
+    }
+    else if (addr.ss_family == AF_INET6)
+    {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+        if (IN6_IS_ADDR_V4MAPPED(&in6.sin6_addr))
+        {
+            inet_ntop(AF_INET, &in6.sin6_addr.s6_addr[12], ip, sizeof(ip));
+        }
+        else
+        {
+            inet_ntop(AF_INET6, &in6.sin6_addr, ip, sizeof(ip));
+            brackets = true;
+        }
+        port = ntohs(in6.sin6_port);
+    }
+
+    return brackets ? "[" + std::string(ip) + "]:" + std::to_string(port)
+                    : std::string(ip) + ":" + std::to_string(port);
+}
@@ -0,0 +1,494 @@
+#include "../include/epoll_backend.hpp"
+#include "../include/reactor.hpp"
+#include "../include/logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+EpollBackend::EpollBackend(Reactor& reactor)
+    :   _reactor{ reactor },
+        _accept_budget{ static_cast<size_t>(reactor.config().accept_budget) },
+        _zerocopy_min{ static_cast<size_t>(reactor.config().zerocopy_threshold) }
+{
+}
+
+EpollBackend::~EpollBackend()
+{
+    for (const auto& [fd, state] : _retired)
+    {
+        close(fd);
+    }
+    if (_epoll_fd >= 0)
+    {
+        close(_epoll_fd);
+    }
+}
+
+bool EpollBackend::start(const std::vector<int>& tcp_sockets, const std::vector<int>& udp_sockets,
+                         int wake_fd, int signal_fd)
+{
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        return false;
+    }
+
+    for (int fd : tcp_sockets)
+    {
+        if (!watch(fd, tag(TAG_LISTENER, _listeners.size()), "epoll_ctl TCP"))
+            return false;
+        _listeners.push_back(Listener{ fd });
+    }
+
+    for (int fd : udp_sockets)
+    {
+        if (!watch(fd, tag(TAG_UDP, static_cast<uint64_t>(fd)), "epoll_ctl UDP"))
+            return false;
+    }
+
+    if (signal_fd >= 0 && !watch(signal_fd, tag(TAG_SIGNAL, 0), "epoll_ctl signalfd"))
+        return false;
+
+    return watch(wake_fd, tag(TAG_WAKE, 0), "epoll_ctl eventfd");
+}
+
+void EpollBackend::stopListening()
+{
+    for (const Listener& listener : _listeners)
+    {
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, listener.fd, nullptr);
+    }
+    _listeners.clear();
+    _accept_pending = false;
+}
+
+bool EpollBackend::watch(int fd, uint64_t token, const char* what)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = token;
+
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        perror(what);
+        return false;
+    }
+
+    return true;
+}
+
+bool EpollBackend::addClient(ClientInfo& client)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLET | EPOLLHUP | EPOLLERR;
+    event.data.u64 = client.token();
+
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, client.fd, &event) < 0)
+    {
+        LOG_ERROR("epoll_ctl client: %s", strerror(errno));
+        return false;
+    }
+
+    // Kernel TLS sockets refuse MSG_ZEROCOPY with EOPNOTSUPP; they always send with copies.
+    if (_zerocopy_min > 0 && !client.ktls)
+    {
+        int on = 1;
+        if (setsockopt(client.fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+        {
+            LOG_WARN("SO_ZEROCOPY: %s, sending with copies", strerror(errno));
+            _zerocopy_min = 0;
+        }
+        else
+        {
+            if (client.slot >= _zerocopy.size())
+            {
+                _zerocopy.resize(static_cast<size_t>(client.slot) + 1);
+            }
+            _zerocopy[client.slot] = ZeroCopyState{};
+        }
+    }
+
+    return true;
+}
+
+void EpollBackend::removeClient(ClientInfo& client)
+{
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client.fd, nullptr);
+
+    if (client.slot < _zerocopy.size() && !_zerocopy[client.slot].pending.empty())
+    {
+        retireZeroCopy(client);
+    }
+}
+
+void EpollBackend::retireZeroCopy(ClientInfo& client)
+{
+    // Queued data is transmitted after close() and may be retransmitted for minutes, but
+    // completions are only reported to an open descriptor. A duplicate keeps the socket,
+    // and its chunks, until they arrive; the reactor's close() then sends nothing, so the
+    // FIN is sent here, after the queued data.
+    ZeroCopyState& state = _zerocopy[client.slot];
+    int fd = fcntl(client.fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        LOG_WARN("F_DUPFD for zero-copy completions: %s, keeping the chunks", strerror(errno));
+        for (auto& [id, chunk] : state.pending)
+        {
+            _abandoned.push_back(std::move(chunk));
+        }
+        state = ZeroCopyState{};
+        return;
+    }
+
+    shutdown(fd, SHUT_WR);
+    unsigned timeout = ZEROCOPY_RETIRE_TIMEOUT_MS;
+    setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+
+    _retired[fd] = std::move(state);
+    state = ZeroCopyState{};
+
+    // Only errors: EPOLLERR announces completions, and input is no longer read.
+    epoll_event event{};
+    event.events = EPOLLET;
+    event.data.u64 = tag(TAG_RETIRED, static_cast<uint64_t>(fd));
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        LOG_ERROR("epoll_ctl retired socket: %s", strerror(errno));
+    }
+
+    // Completions may have been queued before the descriptor was watched.
+    drainRetired(fd);
+}
+
+void EpollBackend::drainRetired(int fd)
+{
+    auto retired = _retired.find(fd);
+    if (retired == _retired.end())
+        return;
+
+    // A socket error ends the connection, and with it the sends: keep draining regardless.
+    drainZeroCopy(fd, retired->second);
+    if (!retired->second.pending.empty())
+        return;
+
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    _retired.erase(retired);
+}
+
+void EpollBackend::resumeRead(ClientInfo& client)
+{
+    // Edge-triggered: whatever arrived while paused produced no new event.
+    readClient(client);
+}
+
+size_t EpollBackend::pendingOutput(const ClientInfo& client) const
+{
+    return client.output.size();
+}
+
+bool EpollBackend::wait(int timeout_ms)
+{
+    if (_accept_pending)
+    {
+        timeout_ms = 0;
+    }
+
+    _ready = epoll_wait(_epoll_fd, _events.data(), MAX_EVENTS, timeout_ms);
+    if (_ready < 0)
+    {
+        if (errno == EINTR)
+        {
+            _ready = 0;
+            return true;
+        }
+        LOG_ERROR("epoll_wait: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+size_t EpollBackend::dispatch()
+{
+    for (int i = 0; i < _ready; ++i)
+    {
+        uint64_t token = _events[i].data.u64;
+
+        if ((token >> 56) == TAG_LISTENER)
+        {
+            _listeners[token & 0xffffffff].pending = true;
+            _accept_pending = true;
+        }
+        else if ((token >> 56) == TAG_UDP)
+        {
+            _reactor.handleUdpData(static_cast<int>(token & 0xffffffff));
+        }
+        else if ((token >> 56) == TAG_WAKE)
+        {
+            _reactor.handleWakeup();
+        }
+        else if ((token >> 56) == TAG_SIGNAL)
+        {
+            _reactor.handleSignal();
+        }
+        else if ((token >> 56) == TAG_RETIRED)
+        {
+            drainRetired(static_cast<int>(token & 0xffffffff));
+        }
+        else
+        {
+            // Events for a connection closed earlier in this batch carry a stale generation.
+            ClientInfo* client = _reactor.resolve(token);
+            if (!client)
+                continue;
+
+            // With MSG_ZEROCOPY, EPOLLERR also announces completed sends.
+            if ((_events[i].events & EPOLLHUP) ||
+                ((_events[i].events & EPOLLERR) && (!zeroCopy(*client) || !drainZeroCopy(client->fd, _zerocopy[client->slot]))))
+            {
+                _reactor.removeClient(*client);
+                continue;
+            }
+
+            if (_events[i].events & EPOLLOUT)
+            {
+                flush(*client);
+                _reactor.onWritable(*client);
+            }
+
+            if ((_events[i].events & EPOLLIN) && client->active)
+            {
+                readClient(*client);
+            }
+        }
+    }
+
+    size_t events = static_cast<size_t>(_ready);
+    _ready = 0;
+    // New connections wait until the established ones have had their turn.
+    if (_accept_pending)
+    {
+        _accept_pending = false;
+        for (size_t i = 0; i < _listeners.size(); ++i)
+        {
+            if (_listeners[i].pending)
+            {
+                acceptConnections(i);
+            }
+        }
+    }
+
+    return events;
+}
+
+void EpollBackend::acceptConnections(size_t index)
+{
+    // The listener is edge-triggered: whatever the budget leaves in the backlog is only
+    // picked up because it stays pending.
+    Listener& listener = _listeners[index];
+    listener.pending = false;
+
+    for (size_t accepted = 0; accepted < _accept_budget; ++accepted)
+    {
+        sockaddr_storage client_addr{};
+        socklen_t addr_len = sizeof(client_addr);
+
+        int client_fd = accept4(listener.fd, (sockaddr*)&client_addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;     // No more pending connections
+
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                // Retrying at once would spin; wait for connections to close.
+                LOG_WARN("accept: %s", strerror(errno));
+                _reactor.timers().schedule(ACCEPT_RETRY_MS, [this, index]()
+                {
+                    if (index < _listeners.size())      // unless listening stopped meanwhile
+                    {
+                        _listeners[index].pending = true;
+                        _accept_pending = true;
+                    }
+                });
+                return;
+            }
+
+            if (errno != EINTR && errno != ECONNABORTED)
+            {
+                LOG_ERROR("accept: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        _reactor.acceptClient(client_fd, client_addr, addr_len);
+    }
+
+    listener.pending = true;
+    _accept_pending = true;
+}
+
+void EpollBackend::readClient(ClientInfo& client)
+{
+    while (client.active && !client.read_paused)
+    {
+        size_t space = 0;
+        char* buffer = _reactor.receiveBuffer(client, space);
+        if (!buffer)
+            return;
+
+        ssize_t bytes = recv(client.fd, buffer, space, 0);
+
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;  // an incomplete line stays buffered until the next event
+            }
+            // With kernel TLS, a record that is not application data (the peer's
+            // close_notify alert) fails the read: the session is over.
+            if (errno != EIO || !client.ktls)
+            {
+                LOG_ERROR("recv: %s", strerror(errno));
+            }
+            _reactor.removeClient(client);
+            return;
+        }
+        else if (bytes == 0)
+        {
+            _reactor.removeClient(client);
+            return;
+        }
+
+        _reactor.onReceived(client, static_cast<size_t>(bytes));
+    }
+}
+
+void EpollBackend::flush(ClientInfo& client)
+{
+    OutputBuffer& output = client.output;
+    std::array<iovec, MAX_IOV> iov;
+
+    while (!output.empty())
+    {
+        msghdr msg{};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = output.gather(iov.data(), MAX_IOV, _zerocopy_min);
+
+        // gather() returns a large shared slice on its own
+        const ChunkRef* chunk = output.frontChunk();
+        bool zerocopy = zeroCopy(client) && msg.msg_iovlen == 1 && chunk &&
+                        iov[0].iov_len >= _zerocopy_min;
+
+        ssize_t sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+        if (sent < 0 && errno == ENOBUFS && zerocopy)
+        {
+            // Out of socket option memory for pinned pages: copy this slice instead.
+            zerocopy = false;
+            sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+        }
+
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;  // the rest stays queued until EPOLLOUT
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("sendmsg: %s", strerror(errno));
+            client.write_failed = true;
+            return;
+        }
+
+        if (zerocopy)
+        {
+            ZeroCopyState& state = _zerocopy[client.slot];
+            state.pending.emplace_back(state.next_id++, *chunk);
+        }
+
+        output.consume(sent);
+        _reactor.onSent(client, static_cast<size_t>(sent));
+    }
+
+    updateWriteInterest(client);
+}
+
+bool EpollBackend::zeroCopy(const ClientInfo& client) const
+{
+    return _zerocopy_min > 0 && !client.ktls;
+}
+
+bool EpollBackend::drainZeroCopy(int fd, ZeroCopyState& state)
+{
+    while (true)
+    {
+        char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            const auto* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0)
+                return false;
+
+            // Sends [ee_info, ee_data] are complete; ids wrap around.
+            while (!state.pending.empty() &&
+                   static_cast<int32_t>(state.pending.front().first - err->ee_data) <= 0)
+            {
+                state.pending.pop_front();
+            }
+        }
+    }
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+}
+
+void EpollBackend::updateWriteInterest(ClientInfo& client)
+{
+    bool want_write = !client.output.empty();
+    if (want_write == client.want_write)
+        return;
+
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLET | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = client.token();
+
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, client.fd, &event) < 0)
+    {
+        LOG_ERROR("epoll_ctl MOD client: %s", strerror(errno));
+        client.write_failed = true;
+        return;
+    }
+
+    client.want_write = want_write;
+}
@@ -0,0 +1,23 @@
+#include "../include/io_backend.hpp"
+#include "../include/epoll_backend.hpp"
+#include "../include/uring_backend.hpp"
+
+bool parseIoBackend(const std::string& name, IoBackendKind& kind)
+{
+    if (name == "epoll") kind = IoBackendKind::Epoll;
+    else if (name == "uring" || name == "io_uring") kind = IoBackendKind::Uring;
+    else return false;
+    return true;
+}
+
+std::unique_ptr<IoBackend> makeIoBackend(IoBackendKind kind, Reactor& reactor)
+{
+    if (kind == IoBackendKind::Uring)
+    {
+        auto uring = std::make_unique<UringBackend>(reactor);
+        if (uring->setup())
+            return uring;
+    }
+
+    return std::make_unique<EpollBackend>(reactor);
+}
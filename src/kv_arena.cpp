@@ -0,0 +1,62 @@
+#include "../include/kv_arena.hpp"
+#include <new>
+
+KvArena::~KvArena() = default;
+
+size_t KvArena::sizeClass(size_t size)
+{
+    size_t index = 0;
+    while ((size_t{ 1 } << (MIN_SHIFT + index)) < size)
+    {
+        ++index;
+    }
+    return index;
+}
+
+void* KvArena::allocate(size_t size, size_t& capacity)
+{
+    size_t index = sizeClass(size);
+    if (index >= CLASSES)
+    {
+        capacity = size;
+        _reserved += size;
+        _used += size;
+        return ::operator new(size);
+    }
+
+    capacity = size_t{ 1 } << (MIN_SHIFT + index);
+    _used += capacity;
+
+    if (FreeBlock* block = _free[index])
+    {
+        _free[index] = block->next;
+        return block;
+    }
+
+    if (_cursor[index] == _end[index])
+    {
+        _slabs.emplace_back(new char[SLAB_SIZE]);
+        _reserved += SLAB_SIZE;
+        _cursor[index] = _slabs.back().get();
+        _end[index] = _cursor[index] + SLAB_SIZE;
+    }
+
+    void* block = _cursor[index];
+    _cursor[index] += capacity;
+    return block;
+}
+
+void KvArena::release(void* block, size_t capacity)
+{
+    _used -= capacity;
+
+    size_t index = sizeClass(capacity);
+    if (index >= CLASSES)
+    {
+        _reserved -= capacity;
+        ::operator delete(block);
+        return;
+    }
+
+    _free[index] = new (block) FreeBlock{ _free[index] };
+}
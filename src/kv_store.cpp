@@ -0,0 +1,195 @@
+#include "../include/kv_store.hpp"
+#include <charconv>
+#include <functional>
+#include <limits>
+
+KvStore::KvStore(size_t shards)
+    :   _shard_count{ 1 }
+{
+    while (_shard_count < shards)
+    {
+        _shard_count *= 2;
+    }
+    _shard_mask = _shard_count - 1;
+    _shards.reset(new Shard[_shard_count]);
+}
+
+uint64_t KvStore::hash(std::string_view key)
+{
+    // Spread the bits: the table takes its tag and group from the low bits, the shard
+    // comes from the high ones.
+    uint64_t h = std::hash<std::string_view>{}(key);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+KvEntry** KvStore::findLive(Shard& shard, std::string_view key, uint64_t hash, uint64_t now_ms)
+{
+    KvEntry** slot = shard.table.find(key, hash);
+    if (slot != nullptr && (*slot)->expires_ms != 0 && (*slot)->expires_ms <= now_ms)
+    {
+        ++shard.expired;
+        erase(shard, slot);
+        return nullptr;
+    }
+    return slot;
+}
+
+void KvStore::erase(Shard& shard, KvEntry** slot)
+{
+    setDeadline(shard, **slot, 0);
+    shard.table.erase(slot);
+}
+
+void KvStore::setDeadline(Shard& shard, KvEntry& entry, uint64_t expires_ms)
+{
+    if ((entry.expires_ms != 0) != (expires_ms != 0))
+    {
+        if (expires_ms != 0)
+        {
+            ++shard.expiring;
+            _expiring.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            --shard.expiring;
+            _expiring.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    entry.expires_ms = expires_ms;
+}
+
+void KvStore::set(std::string_view key, std::string_view value, uint64_t now_ms)
+{
+    uint64_t h = hash(key);
+    Shard& shard = shardOf(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    KvEntry* entry;
+    if (KvEntry** slot = findLive(shard, key, h, now_ms))
+    {
+        entry = shard.table.reserveValue(slot, value.size());
+        setDeadline(shard, *entry, 0);
+    }
+    else
+    {
+        entry = *shard.table.insert(key, h, value.size());
+    }
+    value.copy(entry->value(), value.size());
+}
+
+bool KvStore::del(std::string_view key, uint64_t now_ms)
+{
+    uint64_t h = hash(key);
+    Shard& shard = shardOf(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    KvEntry** slot = findLive(shard, key, h, now_ms);
+    if (slot == nullptr)
+        return false;
+    erase(shard, slot);
+    return true;
+}
+
+KvStore::IncrResult KvStore::incr(std::string_view key, int64_t delta, uint64_t now_ms, int64_t& value)
+{
+    uint64_t h = hash(key);
+    Shard& shard = shardOf(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    KvEntry** slot = findLive(shard, key, h, now_ms);
+    int64_t current = 0;
+    if (slot != nullptr)
+    {
+        std::string_view text = (*slot)->valueView();
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), current);
+        if (error != std::errc() || end != text.data() + text.size())
+            return IncrResult::NotInteger;
+    }
+    if (__builtin_add_overflow(current, delta, &value))
+        return IncrResult::Overflow;
+
+    char buffer[std::numeric_limits<int64_t>::digits10 + 3];
+    size_t length = static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer);
+
+    // The TTL, if any, stays.
+    KvEntry* entry = slot != nullptr ? shard.table.reserveValue(slot, length)
+                                     : *shard.table.insert(key, h, length);
+    std::string_view(buffer, length).copy(entry->value(), length);
+    return IncrResult::Ok;
+}
+
+bool KvStore::expire(std::string_view key, uint64_t ttl_ms, uint64_t now_ms)
+{
+    uint64_t h = hash(key);
+    Shard& shard = shardOf(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    KvEntry** slot = findLive(shard, key, h, now_ms);
+    if (slot == nullptr)
+        return false;
+
+    if (ttl_ms == 0)
+    {
+        ++shard.expired;
+        erase(shard, slot);
+    }
+    else
+    {
+        setDeadline(shard, **slot, now_ms + ttl_ms);
+    }
+    return true;
+}
+
+size_t KvStore::expireSample(uint64_t now_ms)
+{
+    size_t removed = 0;
+    for (size_t i = 0; i < _shard_count; ++i)
+    {
+        Shard& shard = _shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // Another round while more than a quarter of the keys with a TTL looked at had
+        // run out: there are probably many more.
+        for (size_t round = 0; round < SAMPLE_ROUNDS && shard.expiring > 0; ++round)
+        {
+            size_t timed = 0;
+            size_t expired = 0;
+            shard.table.sample(SAMPLE_SLOTS, [&](KvEntry& entry)
+            {
+                if (entry.expires_ms == 0)
+                    return false;
+                ++timed;
+                if (entry.expires_ms > now_ms)
+                    return false;
+                ++expired;
+                setDeadline(shard, entry, 0);
+                return true;
+            });
+
+            shard.expired += expired;
+            removed += expired;
+            if (expired * 4 <= timed)
+                break;
+        }
+    }
+    return removed;
+}
+
+KvStats KvStore::stats() const
+{
+    KvStats stats;
+    for (size_t i = 0; i < _shard_count; ++i)
+    {
+        const Shard& shard = _shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.keys += shard.table.size();
+        stats.memory += shard.table.memory();
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.expired += shard.expired;
+    }
+    return stats;
+}
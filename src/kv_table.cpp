@@ -0,0 +1,263 @@
+#include "../include/kv_table.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// Bit i of the result is set if control byte i of the group at `ctrl` is `tag`.
+uint32_t matchTag(const int8_t* ctrl, int8_t tag)
+{
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < KvTable::GROUP; ++i)
+    {
+        bits |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+    }
+    return bits;
+#endif
+}
+
+// Bit i is set if slot i of the group is EMPTY or DELETED, the only negative control bytes.
+uint32_t matchFree(const int8_t* ctrl)
+{
+#if defined(__SSE2__)
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < KvTable::GROUP; ++i)
+    {
+        bits |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+    }
+    return bits;
+#endif
+}
+
+int8_t tagOf(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+size_t groupOf(uint64_t hash, size_t groups) { return static_cast<size_t>(hash >> 7) & (groups - 1); }
+
+} // namespace
+
+void KvTable::Slots::allocate(size_t slots)
+{
+    ctrl.reset(new int8_t[slots]);
+    std::memset(ctrl.get(), EMPTY, slots);
+    entries.reset(new KvEntry*[slots]);
+    capacity = slots;
+    size = 0;
+    growth_left = slots - slots / 8;
+}
+
+void KvTable::Slots::release()
+{
+    ctrl.reset();
+    entries.reset();
+    capacity = 0;
+    size = 0;
+    growth_left = 0;
+}
+
+KvTable::~KvTable()
+{
+    for (Slots* slots : { &_table, &_old })
+    {
+        for (size_t i = 0; i < slots->capacity; ++i)
+        {
+            if (slots->ctrl[i] >= 0)
+            {
+                KvEntry* entry = slots->entries[i];
+                _arena.release(entry, entry->capacity);
+            }
+        }
+    }
+}
+
+KvEntry** KvTable::lookup(Slots& slots, std::string_view key, uint64_t hash)
+{
+    if (slots.capacity == 0)
+        return nullptr;
+
+    size_t groups = slots.capacity / GROUP;
+    size_t group = groupOf(hash, groups);
+    int8_t tag = tagOf(hash);
+
+    // Triangular steps visit every group of a power-of-two table once.
+    for (size_t step = 1; step <= groups; ++step)
+    {
+        const int8_t* ctrl = &slots.ctrl[group * GROUP];
+        for (uint32_t bits = matchTag(ctrl, tag); bits != 0; bits &= bits - 1)
+        {
+            size_t index = group * GROUP + static_cast<size_t>(__builtin_ctz(bits));
+            KvEntry* entry = slots.entries[index];
+            if (entry->hash == hash && entry->keyView() == key)
+                return &slots.entries[index];
+        }
+
+        if (matchTag(ctrl, EMPTY) != 0)
+            return nullptr;
+        group = (group + step) & (groups - 1);
+    }
+    return nullptr;
+}
+
+size_t KvTable::place(Slots& slots, uint64_t hash)
+{
+    size_t groups = slots.capacity / GROUP;
+    size_t group = groupOf(hash, groups);
+
+    // The probe sequence of lookup(). It always ends: growth_left keeps one slot in eight EMPTY.
+    for (size_t step = 1;; ++step)
+    {
+        uint32_t free = matchFree(&slots.ctrl[group * GROUP]);
+        if (free != 0)
+        {
+            size_t index = group * GROUP + static_cast<size_t>(__builtin_ctz(free));
+            if (slots.ctrl[index] == EMPTY)
+            {
+                --slots.growth_left;
+            }
+            slots.ctrl[index] = tagOf(hash);
+            ++slots.size;
+            return index;
+        }
+        group = (group + step) & (groups - 1);
+    }
+}
+
+void KvTable::clear(Slots& slots, size_t index)
+{
+    // A group that was never full cannot have sent a probe on to the next one, so its
+    // slots can go back to EMPTY; only full groups need a tombstone.
+    size_t group = index / GROUP * GROUP;
+    if (matchTag(&slots.ctrl[group], EMPTY) != 0)
+    {
+        slots.ctrl[index] = EMPTY;
+        ++slots.growth_left;
+    }
+    else
+    {
+        slots.ctrl[index] = DELETED;
+    }
+    --slots.size;
+}
+
+KvEntry** KvTable::find(std::string_view key, uint64_t hash)
+{
+    if (_old.capacity != 0)
+    {
+        migrate(MIGRATE_GROUPS);
+    }
+
+    if (KvEntry** slot = lookup(_table, key, hash))
+        return slot;
+    return _old.capacity != 0 ? lookup(_old, key, hash) : nullptr;
+}
+
+KvEntry** KvTable::insert(std::string_view key, uint64_t hash, size_t value_len)
+{
+    if (_table.growth_left == 0)
+    {
+        grow();
+    }
+
+    size_t index = place(_table, hash);
+    _table.entries[index] = allocateEntry(key, hash, value_len);
+    return &_table.entries[index];
+}
+
+KvEntry* KvTable::reserveValue(KvEntry** slot, size_t value_len)
+{
+    KvEntry* entry = *slot;
+    if (sizeof(KvEntry) + entry->key_len + value_len > entry->capacity)
+    {
+        KvEntry* moved = allocateEntry(entry->keyView(), entry->hash, value_len);
+        moved->expires_ms = entry->expires_ms;
+        _arena.release(entry, entry->capacity);
+        *slot = entry = moved;
+    }
+    entry->value_len = static_cast<uint32_t>(value_len);
+    return entry;
+}
+
+void KvTable::erase(KvEntry** slot)
+{
+    KvEntry* entry = *slot;
+    _arena.release(entry, entry->capacity);
+
+    Slots& slots = slot >= _table.entries.get() && slot < _table.entries.get() + _table.capacity ? _table : _old;
+    clear(slots, static_cast<size_t>(slot - slots.entries.get()));
+}
+
+size_t KvTable::memory() const
+{
+    return (_table.capacity + _old.capacity) * (1 + sizeof(KvEntry*)) + _arena.reserved();
+}
+
+void KvTable::grow()
+{
+    // An unfinished move goes first; the new array was sized to take all of it.
+    if (_old.capacity != 0)
+    {
+        migrate(_old.capacity / GROUP);
+        if (_table.growth_left > 0)
+            return;
+    }
+
+    // Mostly tombstones: rebuild at the same size, else double.
+    size_t capacity = _table.capacity == 0 ? MIN_CAPACITY
+                    : _table.size * 16 < _table.capacity * 7 ? _table.capacity : _table.capacity * 2;
+
+    _old = std::move(_table);
+    _table = Slots{};
+    _table.allocate(capacity);
+    _migrated = 0;
+    if (_old.size == 0)
+    {
+        _old.release();
+    }
+}
+
+void KvTable::migrate(size_t groups)
+{
+    size_t total = _old.capacity / GROUP;
+    for (size_t end = std::min(total, _migrated + groups); _migrated < end; ++_migrated)
+    {
+        for (size_t index = _migrated * GROUP; index < (_migrated + 1) * GROUP; ++index)
+        {
+            if (_old.ctrl[index] < 0)
+                continue;
+
+            KvEntry* entry = _old.entries[index];
+            _table.entries[place(_table, entry->hash)] = entry;
+            // A tombstone, so that probes for keys still in _old pass on.
+            _old.ctrl[index] = DELETED;
+            --_old.size;
+        }
+    }
+
+    if (_migrated == total)
+    {
+        _old.release();
+    }
+}
+
+KvEntry* KvTable::allocateEntry(std::string_view key, uint64_t hash, size_t value_len)
+{
+    size_t capacity = 0;
+    void* block = _arena.allocate(sizeof(KvEntry) + key.size() + value_len, capacity);
+
+    KvEntry* entry = static_cast<KvEntry*>(block);
+    entry->hash = hash;
+    entry->expires_ms = 0;
+    entry->key_len = static_cast<uint32_t>(key.size());
+    entry->value_len = static_cast<uint32_t>(value_len);
+    entry->capacity = capacity;
+    std::memcpy(entry->key(), key.data(), key.size());
+    return entry;
+}
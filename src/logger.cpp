@@ -0,0 +1,345 @@
+#include "../include/logger.hpp"
+#include "../include/loop_clock.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <ctime>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+bool parseLogLevel(const std::string& name, LogLevel& level)
+{
+    if (name == "debug") level = LogLevel::Debug;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "warn") level = LogLevel::Warn;
+    else if (name == "error") level = LogLevel::Error;
+    else return false;
+    return true;
+}
+
+static const char* levelName(LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info:  return "INFO";
+        case LogLevel::Warn:  return "WARN";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "?";
+}
+
+// Appends the text line for one record to `batch`; `stamp` keeps the formatted second
+// of `cached_second` across calls.
+static void appendRecord(std::string& batch, uint64_t timestamp_ns, LogLevel level, const char* text,
+                         size_t length, time_t& cached_second, char (&stamp)[32])
+{
+    time_t second = static_cast<time_t>(timestamp_ns / 1000000000ull);
+    if (second != cached_second)
+    {
+        tm local;
+        localtime_r(&second, &local);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        cached_second = second;
+    }
+
+    char prefix[64];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%s.%03u [%s] ", stamp,
+                              static_cast<unsigned>(timestamp_ns / 1000000ull % 1000), levelName(level));
+    batch.append(prefix, static_cast<size_t>(prefix_len));
+    batch.append(text, length);
+    batch.push_back('\n');
+}
+
+bool LogRateLimit::allow(uint64_t now_s, uint32_t limit, uint32_t& suppressed)
+{
+    suppressed = 0;
+
+    uint64_t window = _window.load(std::memory_order_relaxed);
+    if (window != now_s && _window.compare_exchange_strong(window, now_s, std::memory_order_relaxed))
+    {
+        _count.store(0, std::memory_order_relaxed);
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (limit == 0 || _count.fetch_add(1, std::memory_order_relaxed) < limit)
+        return true;
+
+    _suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool LogRing::push(LogLevel level, uint64_t timestamp_ns, const char* text, size_t length)
+{
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == CAPACITY)
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    LogRecord& record = _records[tail & (CAPACITY - 1)];
+    record.timestamp_ns = timestamp_ns;
+    record.level = level;
+    record.length = static_cast<uint16_t>(length);
+    std::memcpy(record.text, text, length);
+
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+Logger& Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::~Logger()
+{
+    stop();
+
+    if (_wake_fd >= 0)
+    {
+        close(_wake_fd);
+    }
+    if (_fd != 1)
+    {
+        close(_fd);
+    }
+
+    LogRing* ring = _rings.exchange(nullptr);
+    while (ring)
+    {
+        LogRing* next = ring->next;
+        delete ring;
+        ring = next;
+    }
+}
+
+bool Logger::start(const std::string& path, LogLevel level, uint32_t rate_limit)
+{
+    _level = static_cast<uint8_t>(level);
+    _rate_limit = rate_limit;
+
+    if (!path.empty())
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            perror("open log file");
+            return false;
+        }
+        _fd = fd;
+    }
+
+    if (_wake_fd < 0)
+    {
+        _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_wake_fd < 0)
+        {
+            perror("eventfd logger");
+            return false;
+        }
+    }
+
+    _stopped = false;
+    _running = true;
+    _writer = std::thread([this]() { writerLoop(); });
+    return true;
+}
+
+void Logger::stop()
+{
+    if (!_running.exchange(false))
+        return;
+
+    wakeWriter();
+    _writer.join();
+
+    // This thread is the only consumer now; take what arrived after the writer's last look.
+    _stopped.store(true, std::memory_order_release);
+    std::string batch;
+    flush(batch);
+}
+
+LogRing& Logger::localRing()
+{
+    thread_local LogRing* ring = nullptr;
+    if (!ring)
+    {
+        ring = new LogRing();
+        ring->next = _rings.load(std::memory_order_relaxed);
+        while (!_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                             std::memory_order_relaxed))
+        {
+        }
+    }
+    return *ring;
+}
+
+void Logger::log(LogLevel level, LogRateLimit& limit, const char* format, ...)
+{
+    // Event loops stamp records with the time of their current iteration; other threads
+    // read the coarse clock themselves.
+    uint64_t timestamp_ns;
+    if (const LoopClock* clock = LoopClock::current())
+    {
+        timestamp_ns = clock->wallNs();
+    }
+    else
+    {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        timestamp_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    uint32_t suppressed = 0;
+    if (!limit.allow(timestamp_ns / 1000000000ull, _rate_limit.load(std::memory_order_relaxed), suppressed))
+    {
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char text[sizeof(LogRecord::text)];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (length < 0)
+        return;
+
+    size_t used = std::min(static_cast<size_t>(length), sizeof(text) - 1);
+    if (suppressed > 0 && used < sizeof(text) - 1)
+    {
+        int extra = snprintf(text + used, sizeof(text) - used, " [%u similar messages suppressed]", suppressed);
+        if (extra > 0)
+        {
+            used = std::min(used + static_cast<size_t>(extra), sizeof(text) - 1);
+        }
+    }
+
+    if (_stopped.load(std::memory_order_acquire))
+    {
+        std::string line;
+        time_t cached_second = -1;
+        char stamp[32] = "";
+        appendRecord(line, timestamp_ns, level, text, used, cached_second, stamp);
+        writeOut(line);
+        return;
+    }
+
+    localRing().push(level, timestamp_ns, text, used);
+
+    // Pairs with the fence in writerLoop(): either the writer's last look at the rings
+    // finds this record, or this sees the writer asleep. Of the threads that see it, only
+    // the one that clears the flag pays for the wakeup.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_idle.load(std::memory_order_relaxed) && _idle.exchange(false, std::memory_order_relaxed))
+    {
+        wakeWriter();
+    }
+}
+
+void Logger::wakeWriter()
+{
+    // Non-blocking: if the counter is full, a wakeup is pending anyway.
+    uint64_t one = 1;
+    if (_wake_fd >= 0)
+    {
+        ssize_t written = write(_wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+uint64_t Logger::dropped() const
+{
+    uint64_t total = 0;
+    for (LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        total += ring->dropped();
+    }
+    return total;
+}
+
+size_t Logger::flush(std::string& batch)
+{
+    time_t cached_second = -1;
+    char stamp[32] = "";
+    size_t records = 0;
+
+    for (LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        records += ring->drain([&](const LogRecord& record)
+        {
+            appendRecord(batch, record.timestamp_ns, record.level, record.text, record.length,
+                         cached_second, stamp);
+        });
+    }
+
+    writeOut(batch);
+    batch.clear();
+
+    return records;
+}
+
+void Logger::writeOut(const std::string& batch)
+{
+    size_t written = 0;
+    while (written < batch.size())
+    {
+        ssize_t n = write(_fd, batch.data() + written, batch.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;  // nowhere to report it; the batch is lost
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+void Logger::writerLoop()
+{
+    std::string batch;
+    batch.reserve(64 * 1024);
+
+    while (_running.load(std::memory_order_relaxed))
+    {
+        if (flush(batch) > 0)
+            continue;
+
+        // Give a burst a moment to collect into one write.
+        std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        if (flush(batch) > 0)
+            continue;
+
+        // Quiet for a whole interval: sleep until the next record instead of polling.
+        _idle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (flush(batch) > 0)
+        {
+            _idle.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        // A wakeup left over from a record the flush above already took only costs one
+        // more round.
+        pollfd wake{ _wake_fd, POLLIN, 0 };
+        while (poll(&wake, 1, -1) < 0 && errno == EINTR)
+        {
+        }
+        uint64_t count;
+        while (read(_wake_fd, &count, sizeof(count)) > 0)
+        {
+        }
+        _idle.store(false, std::memory_order_relaxed);
+    }
+
+    flush(batch);
+}
@@ -0,0 +1,32 @@
+#include "../include/loop_clock.hpp"
+
+thread_local const LoopClock* LoopClock::_current = nullptr;
+
+void LoopClock::update()
+{
+    _ms = monotonicMs();
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    _wall_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+
+    if (now.tv_sec != _rendered_second)
+    {
+        tm local;
+        localtime_r(&now.tv_sec, &local);
+        _length = strftime(_text, sizeof(_text), "%Y-%m-%d %H:%M:%S", &local);
+        _rendered_second = now.tv_sec;
+    }
+}
+
+uint64_t monotonicNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+uint64_t monotonicMs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
@@ -23,7 +23,7 @@ int main(int argc, char* argv[])
 
     try
     {
-        NetworkServer server(args.tcp_port, args.udp_port);
+        NetworkServer server(args.config);
         
         if (!server.initialize()) 
         {
@@ -0,0 +1,123 @@
+#include "../include/metrics.hpp"
+#include <cstdio>
+
+void ShardHistogram::observe(uint64_t value)
+{
+    size_t index = value == 0 ? 0 : static_cast<size_t>(64 - __builtin_clzll(value));
+    if (index >= BUCKETS)
+    {
+        index = BUCKETS - 1;
+    }
+
+    _buckets[index].add();
+    _count.add();
+    _sum.add(value);
+}
+
+void HistogramSnapshot::add(const ShardHistogram& histogram)
+{
+    for (size_t i = 0; i < ShardHistogram::BUCKETS; ++i)
+    {
+        buckets[i] += histogram.bucket(i);
+    }
+    count += histogram.count();
+    sum += histogram.sum();
+}
+
+uint64_t HistogramSnapshot::quantile(double q) const
+{
+    // Buckets and count are read at slightly different moments; rank by the buckets.
+    uint64_t total = 0;
+    for (uint64_t n : buckets)
+    {
+        total += n;
+    }
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < ShardHistogram::BUCKETS; ++i)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+            return ShardHistogram::upperBound(i);
+    }
+
+    return ShardHistogram::upperBound(ShardHistogram::BUCKETS - 1);
+}
+
+void PrometheusWriter::header(std::string_view name, std::string_view type, std::string_view help)
+{
+    _out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    _out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void PrometheusWriter::series(std::string_view name, std::string_view suffix, std::string_view labels,
+                              std::string_view extra)
+{
+    _out.append(name).append(suffix);
+    if (!labels.empty() || !extra.empty())
+    {
+        _out.append("{").append(labels);
+        if (!labels.empty() && !extra.empty())
+        {
+            _out.append(",");
+        }
+        _out.append(extra).append("}");
+    }
+    _out.append(" ");
+}
+
+void PrometheusWriter::sample(std::string_view name, std::string_view labels, uint64_t value)
+{
+    series(name, "", labels, "");
+    _out.append(std::to_string(value)).append("\n");
+}
+
+void PrometheusWriter::sample(std::string_view name, std::string_view labels, double value)
+{
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%.9g", value);
+    series(name, "", labels, "");
+    _out.append(text, static_cast<size_t>(length)).append("\n");
+}
+
+void PrometheusWriter::histogram(std::string_view name, std::string_view labels,
+                                 const HistogramSnapshot& histogram, double unit)
+{
+    // Only buckets up to the highest non-empty one are listed; +Inf covers the rest.
+    size_t last = 0;
+    for (size_t i = 0; i < ShardHistogram::BUCKETS; ++i)
+    {
+        if (histogram.buckets[i] != 0)
+        {
+            last = i;
+        }
+    }
+
+    uint64_t cumulative = 0;
+    char le[48];
+    for (size_t i = 0; i <= last && i + 1 < ShardHistogram::BUCKETS; ++i)
+    {
+        cumulative += histogram.buckets[i];
+        std::snprintf(le, sizeof(le), "le=\"%.9g\"", static_cast<double>(ShardHistogram::upperBound(i)) * unit);
+        series(name, "_bucket", labels, le);
+        _out.append(std::to_string(cumulative)).append("\n");
+    }
+
+    uint64_t total = 0;
+    for (uint64_t n : histogram.buckets)
+    {
+        total += n;
+    }
+    series(name, "_bucket", labels, "le=\"+Inf\"");
+    _out.append(std::to_string(total)).append("\n");
+
+    char sum[32];
+    int length = std::snprintf(sum, sizeof(sum), "%.9g", static_cast<double>(histogram.sum) * unit);
+    series(name, "_sum", labels, "");
+    _out.append(sum, static_cast<size_t>(length)).append("\n");
+    series(name, "_count", labels, "");
+    _out.append(std::to_string(total)).append("\n");
+}
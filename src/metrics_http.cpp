@@ -0,0 +1,169 @@
+#include "../include/metrics_http.hpp"
+#include "../include/server.hpp"
+#include "../include/logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+MetricsHttpServer::MetricsHttpServer(NetworkServer& server)
+    :   _server{ server }
+{
+}
+
+MetricsHttpServer::~MetricsHttpServer()
+{
+    stop();
+    join();
+    if (_socket >= 0)
+    {
+        close(_socket);
+    }
+    if (_stop_fd >= 0)
+    {
+        close(_stop_fd);
+    }
+}
+
+bool MetricsHttpServer::listen(int port)
+{
+    _stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (_stop_fd < 0)
+    {
+        perror("eventfd metrics");
+        return false;
+    }
+
+    _socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_socket < 0)
+    {
+        perror("socket metrics");
+        return false;
+    }
+
+    int opt = 1;
+    if (setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt SO_REUSEADDR metrics");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(_socket, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind metrics");
+        return false;
+    }
+
+    if (::listen(_socket, 16) < 0)
+    {
+        perror("listen metrics");
+        return false;
+    }
+
+    return true;
+}
+
+void MetricsHttpServer::start()
+{
+    _thread = std::thread([this]() { run(); });
+}
+
+void MetricsHttpServer::stop()
+{
+    uint64_t one = 1;
+    if (_stop_fd >= 0 && write(_stop_fd, &one, sizeof(one)) < 0)
+    {
+        LOG_ERROR("eventfd write: %s", strerror(errno));
+    }
+}
+
+void MetricsHttpServer::join()
+{
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void MetricsHttpServer::run()
+{
+    // Blocks until a scrape or stop(); an idle server costs no wakeups.
+    while (true)
+    {
+        pollfd pfds[2] = { { _socket, POLLIN, 0 }, { _stop_fd, POLLIN, 0 } };
+        int ready = poll(pfds, 2, -1);
+        if (ready <= 0)
+            continue;
+        if (pfds[1].revents)
+            return;
+
+        int fd = accept4(_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EINTR && errno != EAGAIN)
+            {
+                LOG_ERROR("accept metrics: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        serve(fd);
+        close(fd);
+    }
+}
+
+void MetricsHttpServer::serve(int fd)
+{
+    // A scraper that stalls must not hold up the next one for long.
+    timeval timeout{ 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return;
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::string body;
+    const char* status = "200 OK";
+    if (request.compare(0, 4, "GET ") != 0)
+    {
+        status = "405 Method Not Allowed";
+    }
+    else if (request.compare(4, 9, "/metrics ") != 0 && request.compare(4, 9, "/metrics?") != 0)
+    {
+        status = "404 Not Found";
+    }
+    else
+    {
+        _server.writeMetrics(body);
+    }
+
+    std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        sent += static_cast<size_t>(n);
+    }
+}
@@ -1,57 +1,359 @@
 #include <string>
+#include <vector>
 #include <cstring>
 #include <iostream>
 #include "../include/parser.hpp"
+#include "../include/logger.hpp"
+#include "../include/io_backend.hpp"
+#include "../include/token_bucket.hpp"
+#include "../include/pubsub.hpp"
+#include "../include/cpu_affinity.hpp"
 
-CommandLineArgs parseArguments(int argc, char* argv[]) 
+// Reads the value following option argv[i] into `value` and checks it against [min, max].
+// On failure fills args.error / args.error_msg and returns false.
+static bool readIntOption(int argc, char* argv[], int& i, const std::string& arg,
+                          long min, long max, const char* what, int& value, CommandLineArgs& args)
+{
+    if (i + 1 >= argc)
+    {
+        args.error = true;
+        args.error_msg = "Error: " + arg + " requires an argument";
+        return false;
+    }
+
+    long parsed = std::atol(argv[++i]);
+    if (parsed < min || parsed > max)
+    {
+        args.error = true;
+        args.error_msg = "Error: Invalid " + std::string(what) + " (must be " +
+                         std::to_string(min) + "-" + std::to_string(max) + ")";
+        return false;
+    }
+
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+CommandLineArgs parseArguments(int argc, char* argv[])
 {
     CommandLineArgs args;
+    ServerConfig& config = args.config;
 
-    for (int i = 1; i < argc; ++i) 
+    // "--option=value" is the same as "--option value".
+    std::vector<std::string> words;
+    for (int i = 0; i < argc; ++i)
+    {
+        std::string word = argv[i];
+        size_t eq = word.find('=');
+        if (i > 0 && word.compare(0, 2, "--") == 0 && eq != std::string::npos)
+        {
+            words.push_back(word.substr(0, eq));
+            words.push_back(word.substr(eq + 1));
+        }
+        else
+        {
+            words.push_back(std::move(word));
+        }
+    }
+
+    std::vector<char*> split;
+    for (std::string& word : words)
+    {
+        split.push_back(word.data());
+    }
+    argc = static_cast<int>(split.size());
+    argv = split.data();
+
+    for (int i = 1; i < argc; ++i)
     {
         std::string arg = argv[i];
 
-        if (arg == "-h" || arg == "--help") 
+        if (arg == "-h" || arg == "--help")
         {
             args.show_help = true;
             return args;
         }
 
-        if (arg == "-t" || arg == "--tcp-port") 
+        if (arg == "-t" || arg == "--tcp-port")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 65535, "TCP port number", config.tcp_port, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "-u" || arg == "--udp-port")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 65535, "UDP port number", config.udp_port, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--listen" || arg == "--udp-listen")
+        {
+            std::vector<Endpoint>& endpoints = arg == "--listen" ? config.tcp_listen : config.udp_listen;
+            if (i + 1 >= argc || !parseEndpointList(argv[i + 1], endpoints))
+            {
+                args.error = true;
+                args.error_msg = "Error: " + arg + " requires ADDR:PORT[,ADDR:PORT...]";
+                return args;
+            }
+            ++i;
+            continue;
+        }
+
+        if (arg == "-n" || arg == "--threads")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 1024, "number of threads", config.threads, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--workers")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 256, "number of worker threads", config.worker_threads, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--max-connections")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 10000000, "connection limit", config.max_connections, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--accept-batch")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 65536, "accept batch", config.accept_budget, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--defer-accept")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 3600, "defer accept seconds", config.defer_accept_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--max-line")
+        {
+            if (!readIntOption(argc, argv, i, arg, 64, 16 * 1024 * 1024, "maximum line length",
+                               config.max_line_length, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--write-hwm")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1024, 1 << 30, "write high-water mark",
+                               config.write_high_water, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--udp-batch")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 1024, "UDP batch size", config.udp_batch, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--udp-peers")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 1 << 24, "UDP peer capacity", config.udp_peer_capacity, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--udp-idle")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 86400, "UDP idle timeout", config.udp_peer_idle_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--idle-timeout")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 86400, "idle timeout", config.idle_timeout_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--read-timeout")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 86400, "read timeout", config.read_timeout_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--write-timeout")
         {
-            if (i + 1 >= argc) 
+            if (!readIntOption(argc, argv, i, arg, 0, 86400, "write timeout", config.write_timeout_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--drain-timeout")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 3600, "drain timeout", config.drain_timeout_seconds, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--client-rate" || arg == "--client-burst" || arg == "--udp-rate" || arg == "--udp-burst")
+        {
+            int& value = arg == "--client-rate" ? config.client_rate
+                       : arg == "--client-burst" ? config.client_burst
+                       : arg == "--udp-rate" ? config.udp_rate : config.udp_burst;
+            if (!readIntOption(argc, argv, i, arg, 0, 10000000, "message rate", value, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--command-rate")
+        {
+            // NAME=N, e.g. /stats=10; checked against the registered commands at startup.
+            std::string value = i + 1 < argc ? argv[i + 1] : "";
+            size_t eq = value.find('=');
+            long rate = eq != std::string::npos ? std::atol(value.c_str() + eq + 1) : 0;
+            if (eq == std::string::npos || eq == 0 || rate < 1 || rate > 10000000)
+            {
+                args.error = true;
+                args.error_msg = "Error: --command-rate requires /COMMAND=N with N in 1-10000000";
+                return args;
+            }
+            config.command_rates.emplace_back(value.substr(0, eq), static_cast<int>(rate));
+            ++i;
+            continue;
+        }
+
+        if (arg == "--rate-action")
+        {
+            RateAction action;
+            if (i + 1 >= argc || !parseRateAction(argv[i + 1], action))
             {
                 args.error = true;
-                args.error_msg = "Error: " + arg + " requires an argument";
+                args.error_msg = "Error: --rate-action requires one of drop, delay, reject";
                 return args;
             }
+            config.rate_action = argv[++i];
+            continue;
+        }
+
+        if (arg == "--slow-subscriber")
+        {
+            SlowSubscriber policy;
+            if (i + 1 >= argc || !parseSlowSubscriber(argv[i + 1], policy))
+            {
+                args.error = true;
+                args.error_msg = "Error: --slow-subscriber requires one of drop, disconnect";
+                return args;
+            }
+            config.slow_subscriber = argv[++i];
+            continue;
+        }
+
+        if (arg == "--log-level")
+        {
+            LogLevel level;
+            if (i + 1 >= argc || !parseLogLevel(argv[i + 1], level))
+            {
+                args.error = true;
+                args.error_msg = "Error: --log-level requires one of debug, info, warn, error";
+                return args;
+            }
+            config.log_level = argv[++i];
+            continue;
+        }
+
+        if (arg == "--log-file")
+        {
+            if (i + 1 >= argc)
+            {
+                args.error = true;
+                args.error_msg = "Error: --log-file requires an argument";
+                return args;
+            }
+            config.log_file = argv[++i];
+            continue;
+        }
 
-            args.tcp_port = std::atoi(argv[++i]);
-            if (args.tcp_port <= 0 || args.tcp_port > 65535) 
+        if (arg == "--log-rate")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 1000000, "log rate", config.log_rate_limit, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--metrics-port")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 65535, "metrics port number", config.metrics_port, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--low-latency")
+        {
+            config.low_latency = true;
+            continue;
+        }
+
+        if (arg == "--busy-poll")
+        {
+            if (!readIntOption(argc, argv, i, arg, 1, 100000, "busy poll microseconds", config.busy_poll_usec, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--cpus")
+        {
+            if (i + 1 >= argc || !parseCpuList(argv[i + 1], config.cpus))
             {
                 args.error = true;
-                args.error_msg = "Error: Invalid TCP port number (must be 1-65535)";
+                args.error_msg = "Error: --cpus requires a CPU list such as 0-3,8";
                 return args;
             }
+            ++i;
             continue;
         }
 
-        if (arg == "-u" || arg == "--udp-port") 
+        if (arg == "--tls-port")
         {
-            if (i + 1 >= argc) 
+            if (!readIntOption(argc, argv, i, arg, 0, 65535, "TLS port number", config.tls_port, args))
+                return args;
+            continue;
+        }
+
+        if (arg == "--tls-cert" || arg == "--tls-key")
+        {
+            if (i + 1 >= argc)
             {
                 args.error = true;
-                args.error_msg = "Error: " + arg + " requires an argument";
+                args.error_msg = "Error: " + arg + " requires a PEM file";
                 return args;
             }
+            (arg == "--tls-cert" ? config.tls_cert : config.tls_key) = argv[++i];
+            continue;
+        }
+
+        if (arg == "--zerocopy")
+        {
+            if (!readIntOption(argc, argv, i, arg, 0, 1 << 30, "zero-copy threshold", config.zerocopy_threshold, args))
+                return args;
+            continue;
+        }
 
-            args.udp_port = std::atoi(argv[++i]);
-            if (args.udp_port <= 0 || args.udp_port > 65535) 
+        if (arg == "--io-backend")
+        {
+            IoBackendKind kind;
+            if (i + 1 >= argc || !parseIoBackend(argv[i + 1], kind))
             {
                 args.error = true;
-                args.error_msg = "Error: Invalid UDP port number (must be 1-65535)";
+                args.error_msg = "Error: --io-backend requires one of epoll, uring";
                 return args;
             }
+            config.io_backend = argv[++i];
             continue;
         }
 
@@ -60,13 +362,37 @@ CommandLineArgs parseArguments(int argc, char* argv[])
         return args;
     }
 
-    if (args.tcp_port == args.udp_port) 
+    if (config.tcp_port == config.udp_port)
     {
         args.error = true;
         args.error_msg = "Error: TCP and UDP ports must be different";
         return args;
     }
 
+    if (config.metrics_port == config.tcp_port || config.metrics_port == config.udp_port)
+    {
+        args.error = true;
+        args.error_msg = "Error: the metrics port must differ from the TCP and UDP ports";
+        return args;
+    }
+
+    if (config.tls_port > 0)
+    {
+        if (config.tls_port == config.tcp_port || config.tls_port == config.udp_port
+            || config.tls_port == config.metrics_port)
+        {
+            args.error = true;
+            args.error_msg = "Error: the TLS port must differ from the TCP, UDP and metrics ports";
+            return args;
+        }
+        if (config.tls_cert.empty() || config.tls_key.empty())
+        {
+            args.error = true;
+            args.error_msg = "Error: --tls-port requires --tls-cert and --tls-key";
+            return args;
+        }
+    }
+
     return args;
 }
 
@@ -76,11 +402,49 @@ void printUsage(const char* program_name)
               << "Options:\n"
               << "  -t, --tcp-port PORT    Set TCP port (default: 8080)\n"
               << "  -u, --udp-port PORT    Set UDP port (default: 8081)\n"
+              << "      --listen LIST      TCP addresses to bind, e.g. [::]:8080,10.0.0.5:9090 (default: [::]:PORT)\n"
+              << "      --udp-listen LIST  UDP addresses to bind, same form (default: [::]:PORT)\n"
+              << "  -n, --threads N        Number of reactor threads (default: 1)\n"
+              << "      --workers N        Worker threads for offloaded commands, 0 = inline (default: 2)\n"
+              << "      --max-connections N Open TCP connections before new ones are reset, 0 = unlimited (default: 0)\n"
+              << "      --accept-batch N   Connections accepted per event loop iteration (default: 64)\n"
+              << "      --defer-accept SEC Accept a connection only once it sends data, up to SEC seconds, 0 = off (default: 0)\n"
+              << "      --max-line BYTES   Maximum TCP line length (default: 65536)\n"
+              << "      --write-hwm BYTES  Pause reading a client above this much queued output (default: 1048576)\n"
+              << "      --udp-batch N      Datagrams per recvmmsg/sendmmsg batch (default: 32)\n"
+              << "      --udp-peers N      UDP peers tracked per reactor (default: 16384)\n"
+              << "      --udp-idle SEC     Expire UDP peers idle for SEC seconds (default: 60)\n"
+              << "      --idle-timeout SEC Close TCP clients idle for SEC seconds, 0 = never (default: 300)\n"
+              << "      --read-timeout SEC Time allowed to finish a started line, 0 = none (default: 30)\n"
+              << "      --write-timeout SEC Time allowed for queued output to progress, 0 = none (default: 30)\n"
+              << "      --drain-timeout SEC Time on shutdown for queued replies to go out (default: 5)\n"
+              << "      --client-rate N    Messages per second per TCP connection, 0 = unlimited (default: 0)\n"
+              << "      --client-burst N   Messages a TCP connection may send at once, 0 = one second's worth (default: 0)\n"
+              << "      --udp-rate N       Messages per second per UDP peer, 0 = unlimited (default: 0)\n"
+              << "      --udp-burst N      Messages a UDP peer may send at once, 0 = one second's worth (default: 0)\n"
+              << "      --command-rate /CMD=N Calls of /CMD per second over all clients; may be repeated\n"
+              << "      --rate-action ACTION Over a limit: drop, delay (TCP only; UDP drops) or reject (default: delay)\n"
+              << "      --slow-subscriber POLICY Subscriber at --write-hwm: drop the message or disconnect (default: drop)\n"
+              << "      --log-level LEVEL  debug, info, warn or error (default: info)\n"
+              << "      --log-file PATH    Append log records to PATH instead of stdout\n"
+              << "      --log-rate N       Log records per second per message, 0 = unlimited (default: 100)\n"
+              << "      --io-backend NAME  epoll, or uring for io_uring on Linux 5.19+ (default: epoll)\n"
+              << "      --zerocopy BYTES   Send echoes of BYTES or more with MSG_ZEROCOPY (epoll), 0 = off (default: 0)\n"
+              << "      --low-latency      Poll for events without sleeping before blocking, and busy-poll sockets\n"
+              << "      --busy-poll USEC   Polling budget per wait with --low-latency (default: 50)\n"
+              << "      --cpus LIST        Pin reactor i to the i-th CPU of LIST, e.g. 0-3,8 (default: unpinned)\n"
+              << "      --metrics-port PORT Serve Prometheus metrics on 127.0.0.1:PORT/metrics, 0 = off (default: 0)\n"
+              << "      --tls-port PORT    TLS listener with kernel TLS offload (build with make TLS=1), 0 = off (default: 0)\n"
+              << "      --tls-cert PATH    PEM certificate chain for --tls-port\n"
+              << "      --tls-key PATH     PEM private key for --tls-port\n"
               << "  -h, --help             Show this help message\n"
               << "\nCommands supported by the server:\n"
               << "  /time      - Get current date and time\n"
               << "  /stats     - Get server statistics\n"
               << "  /shutdown  - Shutdown the server\n"
+              << "  /subscribe <channel>, /unsubscribe [channel], /publish <channel> <message> - Pub/sub\n"
+              << "  /set <key> <value>, /get <key>, /del <key>..., /incr <key> [delta], /expire <key> <seconds> - Key-value store\n"
+              << "  /sleep <ms> - Reply after ms milliseconds, on the worker pool\n"
               << "\nExample:\n"
               << "  " << program_name << " --tcp-port 9090 --udp-port 9091\n";
-}
\ No newline at end of file
+}
@@ -0,0 +1,147 @@
+#include "../include/peer_table.hpp"
+#include <cstring>
+
+UdpPeerTable::UdpPeerTable(size_t capacity, uint64_t idle_timeout_ms)
+    :   _capacity{ capacity }, _idle_timeout_ms{ idle_timeout_ms }
+{
+    size_t slots = 16;
+    while (slots < capacity * 2)
+    {
+        slots <<= 1;
+    }
+
+    _slots.assign(slots, UdpPeer{});
+    _mask = slots - 1;
+}
+
+UdpPeerKey UdpPeerTable::makeKey(const sockaddr_storage& addr)
+{
+    UdpPeerKey key;
+    if (addr.ss_family == AF_INET6)
+    {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+        std::memcpy(&key.high, in6.sin6_addr.s6_addr, 8);
+        std::memcpy(&key.low, in6.sin6_addr.s6_addr + 8, 8);
+        key.port = ntohs(in6.sin6_port);
+    }
+    else
+    {
+        // The form a dual-stack socket reports the same peer in: ::ffff:a.b.c.d
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+        unsigned char mapped[8] = { 0, 0, 0xff, 0xff };
+        std::memcpy(mapped + 4, &in.sin_addr, 4);
+        std::memcpy(&key.low, mapped, 8);
+        key.port = ntohs(in.sin_port);
+    }
+    return key;
+}
+
+size_t UdpPeerTable::home(const UdpPeerKey& key) const
+{
+    return static_cast<size_t>(key.hash() >> 20) & _mask;
+}
+
+UdpPeer& UdpPeerTable::touch(const UdpPeerKey& key, uint64_t now_ms, bool& inserted)
+{
+    size_t slot = home(key);
+    while (!_slots[slot].key.empty())
+    {
+        if (_slots[slot].key == key)
+        {
+            inserted = false;
+            _slots[slot].last_seen_ms = now_ms;
+            return _slots[slot];
+        }
+        slot = (slot + 1) & _mask;
+    }
+
+    if (_size >= _capacity)
+    {
+        erase(evictOldest(home(key)));
+        ++_evicted;
+
+        // Backward shifting may have moved entries, so find the free slot again.
+        slot = home(key);
+        while (!_slots[slot].key.empty())
+        {
+            slot = (slot + 1) & _mask;
+        }
+    }
+
+    _slots[slot] = UdpPeer{ key, now_ms, 0, 0, 0, 0, TokenBucket{} };
+    ++_size;
+    inserted = true;
+    return _slots[slot];
+}
+
+bool UdpPeerTable::contains(const UdpPeerKey& key) const
+{
+    for (size_t slot = home(key); !_slots[slot].key.empty(); slot = (slot + 1) & _mask)
+    {
+        if (_slots[slot].key == key)
+            return true;
+    }
+    return false;
+}
+
+size_t UdpPeerTable::evictOldest(size_t start)
+{
+    // Sampled LRU: the oldest of the first few occupied slots from `start`.
+    size_t oldest = _slots.size();
+    size_t sampled = 0;
+
+    for (size_t slot = start; sampled < EVICTION_SAMPLE; slot = (slot + 1) & _mask)
+    {
+        if (_slots[slot].key.empty())
+            continue;
+
+        if (oldest == _slots.size() || _slots[slot].last_seen_ms < _slots[oldest].last_seen_ms)
+        {
+            oldest = slot;
+        }
+        ++sampled;
+    }
+
+    return oldest;
+}
+
+void UdpPeerTable::erase(size_t slot)
+{
+    size_t hole = slot;
+    size_t next = (slot + 1) & _mask;
+
+    // Pull later members of the probe run back so no lookup hits a premature gap.
+    while (!_slots[next].key.empty())
+    {
+        size_t ideal = home(_slots[next].key);
+        if (((next - ideal) & _mask) >= ((next - hole) & _mask))
+        {
+            _slots[hole] = _slots[next];
+            hole = next;
+        }
+        next = (next + 1) & _mask;
+    }
+
+    _slots[hole].key = UdpPeerKey{};
+    --_size;
+}
+
+size_t UdpPeerTable::expire(uint64_t now_ms)
+{
+    size_t removed = 0;
+
+    for (size_t slot = 0; slot < _slots.size();)
+    {
+        const UdpPeer& peer = _slots[slot];
+        if (!peer.key.empty() && now_ms - peer.last_seen_ms > _idle_timeout_ms)
+        {
+            // erase() may shift another entry into this slot, so look at it again.
+            erase(slot);
+            ++removed;
+            continue;
+        }
+        ++slot;
+    }
+
+    return removed;
+}
@@ -0,0 +1,179 @@
+#include "../include/pubsub.hpp"
+
+ChannelTable::Result ChannelTable::subscribe(std::string_view name, uint64_t token,
+                                             std::vector<Subscription>& subscriptions)
+{
+    uint32_t id = find(name);
+    if (id != NONE)
+    {
+        for (const Subscription& subscription : subscriptions)
+        {
+            if (subscription.channel == id)
+                return Result::Exists;
+        }
+    }
+    if (subscriptions.size() >= MAX_SUBSCRIPTIONS)
+        return Result::Full;
+
+    id = open(name);
+    Channel& channel = _channels[id];
+    subscriptions.push_back(Subscription{ id, ++_serial });
+    channel.tcp.push_back(TcpSubscriber{ token, _serial });
+    ++channel.live;
+    ++_subscriptions;
+    return Result::Added;
+}
+
+ChannelTable::Result ChannelTable::subscribe(std::string_view name, const UdpPeerKey& key,
+                                             const sockaddr_storage& addr, socklen_t addr_len,
+                                             int socket, bool framed)
+{
+    auto it = _udp_peers.find(key);
+    if (it == _udp_peers.end())
+    {
+        it = _udp_peers.emplace(key, UdpPeerSubscriptions{}).first;
+    }
+
+    // The latest subscribe decides where and how the peer gets its messages.
+    UdpPeerSubscriptions& peer = it->second;
+    peer.addr = addr;
+    peer.addr_len = addr_len;
+    peer.socket = socket;
+    peer.framed = framed;
+
+    uint32_t id = find(name);
+    if (id != NONE)
+    {
+        for (const Subscription& subscription : peer.subscriptions)
+        {
+            if (subscription.channel == id)
+                return Result::Exists;
+        }
+    }
+    if (peer.subscriptions.size() >= MAX_SUBSCRIPTIONS)
+        return Result::Full;
+
+    id = open(name);
+    Channel& channel = _channels[id];
+    peer.subscriptions.push_back(Subscription{ id, ++_serial });
+    channel.udp.push_back(UdpSubscriber{ key, _serial });
+    ++channel.live;
+    ++_subscriptions;
+    return Result::Added;
+}
+
+size_t ChannelTable::unsubscribe(std::vector<Subscription>& subscriptions, std::string_view name)
+{
+    if (name.empty())
+    {
+        size_t count = subscriptions.size();
+        for (const Subscription& subscription : subscriptions)
+        {
+            leave(subscription.channel);
+        }
+        subscriptions.clear();
+        return count;
+    }
+
+    uint32_t id = find(name);
+    for (size_t i = 0; i < subscriptions.size(); ++i)
+    {
+        if (subscriptions[i].channel == id)
+        {
+            subscriptions[i] = subscriptions.back();
+            subscriptions.pop_back();
+            leave(id);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+size_t ChannelTable::unsubscribe(const UdpPeerKey& key, std::string_view name)
+{
+    auto it = _udp_peers.find(key);
+    if (it == _udp_peers.end())
+        return 0;
+
+    size_t count = unsubscribe(it->second.subscriptions, name);
+    if (it->second.subscriptions.empty())
+    {
+        _udp_peers.erase(it);
+    }
+    return count;
+}
+
+uint32_t ChannelTable::find(std::string_view name) const
+{
+    auto it = _index.find(name);
+    return it != _index.end() ? it->second : NONE;
+}
+
+bool ChannelTable::needsSweep(uint32_t id) const
+{
+    const Channel& channel = _channels[id];
+    return channel.tcp.size() + channel.udp.size() >= 2 * channel.live + SWEEP_SLACK;
+}
+
+const ChannelTable::UdpPeerSubscriptions* ChannelTable::udpPeer(const UdpPeerKey& key) const
+{
+    auto it = _udp_peers.find(key);
+    return it != _udp_peers.end() ? &it->second : nullptr;
+}
+
+bool ChannelTable::contains(const std::vector<Subscription>& subscriptions, uint32_t channel, uint64_t serial)
+{
+    for (const Subscription& subscription : subscriptions)
+    {
+        if (subscription.channel == channel)
+            return subscription.serial == serial;
+    }
+    return false;
+}
+
+uint32_t ChannelTable::open(std::string_view name)
+{
+    uint32_t id = find(name);
+    if (id != NONE)
+        return id;
+
+    if (!_free.empty())
+    {
+        id = _free.back();
+        _free.pop_back();
+    }
+    else
+    {
+        id = static_cast<uint32_t>(_channels.size());
+        _channels.emplace_back();
+    }
+
+    Channel& channel = _channels[id];
+    channel.name = std::string(name);
+    _index.emplace(channel.name, id);
+    return id;
+}
+
+void ChannelTable::leave(uint32_t id)
+{
+    Channel& channel = _channels[id];
+    --channel.live;
+    --_subscriptions;
+
+    if (channel.live == 0 && _walking != id)
+    {
+        close(id);
+    }
+}
+
+void ChannelTable::close(uint32_t id)
+{
+    Channel& channel = _channels[id];
+    _index.erase(channel.name);
+
+    // Whatever is left is stale; the memory goes with it.
+    std::vector<TcpSubscriber>().swap(channel.tcp);
+    std::vector<UdpSubscriber>().swap(channel.udp);
+    channel.name.clear();
+    _free.push_back(id);
+}
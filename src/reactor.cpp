@@ -0,0 +1,1623 @@
+#include "../include/reactor.hpp"
+#include "../include/server.hpp"
+#include "../include/logger.hpp"
+#include "../include/cpu_affinity.hpp"
+#include <iostream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+Reactor::Reactor(NetworkServer& server, const ServerConfig& config, int id)
+    :   _server{ server }, _config{ config }, _id{ id },
+        _cpu{ config.cpus.empty() ? -1 : config.cpus[static_cast<size_t>(id) % config.cpus.size()] },
+        _udp_batch{ static_cast<size_t>(config.udp_batch) },
+        _timers{ _clock.ms() },
+        _udp_peers{ static_cast<size_t>(config.udp_peer_capacity),
+                    static_cast<uint64_t>(config.udp_peer_idle_seconds) * 1000 },
+        _max_connections{ static_cast<size_t>((config.max_connections + config.threads - 1) / config.threads) }
+{
+}
+
+Reactor::~Reactor()
+{
+    closeAll();
+
+    // Commands that finished after the loop stopped are never answered.
+    OffloadedCommand* command = _completions.takeAll();
+    while (command)
+    {
+        std::unique_ptr<OffloadedCommand> done(command);
+        command = command->next;
+    }
+
+    PublicationDelivery* delivery = _publications.takeAll();
+    while (delivery)
+    {
+        std::unique_ptr<PublicationDelivery> done(delivery);
+        delivery = delivery->next;
+    }
+
+    AdoptedClient* adopted = _adopted.takeAll();
+    while (adopted)
+    {
+        std::unique_ptr<AdoptedClient> done(adopted);
+        adopted = adopted->next;
+        close(done->fd);
+    }
+
+    if (_wake_fd >= 0)
+    {
+        close(_wake_fd);
+    }
+}
+
+bool Reactor::initialize(int signal_fd)
+{
+    _signal_fd = signal_fd;
+
+    for (Endpoint endpoint : listenEndpoints(_config.tcp_listen, _config.tcp_port))
+    {
+        int sock = createTcpSocket(endpoint);
+        if (sock < 0)
+        {
+            std::cerr << "[ERROR] Failed to create TCP socket on " << formatAddress(endpoint.addr) << "." << std::endl;
+            return false;
+        }
+        _tcp_sockets.push_back(sock);
+    }
+
+    for (Endpoint endpoint : listenEndpoints(_config.udp_listen, _config.udp_port))
+    {
+        int sock = createUdpSocket(endpoint);
+        if (sock < 0)
+        {
+            std::cerr << "[ERROR] Failed to create UDP socket on " << formatAddress(endpoint.addr) << "." << std::endl;
+            return false;
+        }
+        _udp_sockets.push_back(sock);
+    }
+    _udp_batch.probe(_udp_sockets.front());
+
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wake_fd < 0)
+    {
+        perror("eventfd");
+        return false;
+    }
+
+    // Connection and peer limits hold per record; a command's limit is for the whole
+    // server, so each reactor gets its share.
+    parseRateAction(_config.rate_action, _rate_action);    // validated by the parser
+    _client_limit = RateLimit{ static_cast<uint32_t>(_config.client_rate),
+                               static_cast<uint32_t>(_config.client_burst ? _config.client_burst : _config.client_rate) };
+    _udp_limit = RateLimit{ static_cast<uint32_t>(_config.udp_rate),
+                            static_cast<uint32_t>(_config.udp_burst ? _config.udp_burst : _config.udp_rate) };
+
+    const CommandRegistry& commands = _server.commands();
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        uint32_t rate = commands.rateLimit(i);
+        if (rate == 0)
+            continue;
+
+        _command_limits.resize(commands.size());
+        uint32_t share = (rate + _config.threads - 1) / _config.threads;
+        _command_limits[i].limit = RateLimit{ share, share };
+    }
+    _rate_limited = _client_limit.rate > 0 || _udp_limit.rate > 0 || !_command_limits.empty();
+
+    parseSlowSubscriber(_config.slow_subscriber, _slow_subscriber);    // validated by the parser
+
+    IoBackendKind kind = IoBackendKind::Epoll;
+    parseIoBackend(_config.io_backend, kind);   // validated by the parser
+    _io = makeIoBackend(kind, *this);
+
+    if (!_io->start(_tcp_sockets, _udp_sockets, _wake_fd, _signal_fd))
+    {
+        std::cerr << "[ERROR] Failed to start the " << _io->name() << " backend." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Reactor::setReusePort(int fd)
+{
+    // A single reactor owns the port alone; SO_REUSEPORT is only needed to shard it.
+    if (_config.threads <= 1)
+        return true;
+
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt SO_REUSEPORT");
+        return false;
+    }
+
+    return true;
+}
+
+int Reactor::createTcpSocket(Endpoint& endpoint)
+{
+    int sock = openSocket(endpoint, SOCK_STREAM);
+    if (sock < 0)
+        return -1;
+
+    int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)))
+    {
+        perror("setsockopt SO_REUSEADDR");
+        close(sock);
+        return -1;
+    }
+
+    if (!setReusePort(sock) || !setNonBlocking(sock))
+    {
+        close(sock);
+        return -1;
+    }
+
+    if (_config.low_latency)
+    {
+        setBusyPoll(sock);
+    }
+
+    if (_config.defer_accept_seconds > 0)
+    {
+        // Connections that never send anything are dropped by the kernel, unseen.
+        int seconds = _config.defer_accept_seconds;
+        if (setsockopt(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds)) < 0)
+        {
+            perror("setsockopt TCP_DEFER_ACCEPT");
+            close(sock);
+            return -1;
+        }
+    }
+
+    if (bind(sock, (sockaddr*)&endpoint.addr, endpoint.addr_len) < 0)
+    {
+        perror("bind TCP");
+        close(sock);
+        return -1;
+    }
+
+    if (listen(sock, SOMAXCONN) < 0)
+    {
+        perror("listen");
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+int Reactor::createUdpSocket(Endpoint& endpoint)
+{
+    int sock = openSocket(endpoint, SOCK_DGRAM);
+    if (sock < 0)
+        return -1;
+
+    int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt SO_REUSEADDR UDP");
+        close(sock);
+        return -1;
+    }
+
+    if (!setReusePort(sock) || !setNonBlocking(sock))
+    {
+        close(sock);
+        return -1;
+    }
+
+    if (_config.low_latency)
+    {
+        setBusyPoll(sock);
+    }
+
+    if (bind(sock, (sockaddr*)&endpoint.addr, endpoint.addr_len) < 0)
+    {
+        perror("bind UDP");
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        perror("fcntl F_GETFL");
+        return false;
+    }
+
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        perror("fcntl F_SETFL");
+        return false;
+    }
+
+    return true;
+}
+
+void Reactor::run()
+{
+    // First, so that what the loop allocates is faulted in on this CPU's NUMA node.
+    if (_cpu >= 0 && !pinThread(_cpu))
+    {
+        LOG_WARN("Reactor %d: cannot pin to CPU %d: %s", _id, _cpu, strerror(errno));
+    }
+
+    _clock.update();
+    LoopClock::setCurrent(&_clock);
+
+    while (true)
+    {
+        if (!_draining && !_server.isRunning())
+        {
+            beginDrain();
+        }
+        if (_draining && (_connections.size() == 0 || _drain_expired))
+            break;
+
+        // Sleep until the next timer is due, or indefinitely: shutdown requests, signals
+        // and finished commands all arrive as events.
+        int timeout_ms = _timers.timeoutMs(_clock.ms());
+        if (!(_config.low_latency && timeout_ms != 0 ? busyWait(timeout_ms) : _io->wait(timeout_ms)))
+            break;
+
+        _clock.update();
+        _timers.advance(_clock.ms());
+        _metrics.loop_events.observe(_io->dispatch());
+
+        if (_draining)
+        {
+            closeDrained();
+        }
+    }
+
+    closeAll();
+    LoopClock::setCurrent(nullptr);
+}
+
+bool Reactor::busyWait(int timeout_ms)
+{
+    uint64_t start = monotonicNs();
+    uint64_t budget = static_cast<uint64_t>(_config.busy_poll_usec) * 1000;
+    if (timeout_ms > 0)
+    {
+        budget = std::min(budget, static_cast<uint64_t>(timeout_ms) * 1000000);
+    }
+
+    uint64_t now = start;
+    do
+    {
+        if (!_io->wait(0))
+            return false;
+        now = monotonicNs();
+        if (_io->ready())
+        {
+            _metrics.spin_ns.add(now - start);
+            _metrics.spin_hits.add();
+            return true;
+        }
+    } while (now - start < budget);
+    _metrics.spin_ns.add(now - start);
+
+    if (timeout_ms > 0)
+    {
+        timeout_ms = std::max(0, timeout_ms - static_cast<int>((now - start) / 1000000));
+    }
+    bool ok = _io->wait(timeout_ms);
+    _metrics.sleep_ns.add(monotonicNs() - now);
+    return ok;
+}
+
+void Reactor::setBusyPoll(int fd)
+{
+    // Accepted connections inherit both from their listener. Raising SO_BUSY_POLL above
+    // net.core.busy_read takes CAP_NET_ADMIN; without it the loop still spins.
+    int usec = _config.busy_poll_usec;
+    int prefer = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0
+        || setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0)
+    {
+        LOG_WARN("Reactor %d: socket busy polling unavailable: %s", _id, strerror(errno));
+    }
+}
+
+void Reactor::wake()
+{
+    uint64_t one = 1;
+    if (write(_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        LOG_ERROR("eventfd write: %s", strerror(errno));
+    }
+}
+
+void Reactor::beginDrain()
+{
+    _draining = true;
+
+    _io->stopListening();
+    for (int sock : _tcp_sockets)
+    {
+        close(sock);
+    }
+    _tcp_sockets.clear();
+
+    // Requests not read yet are dropped; replies already queued, and those of commands
+    // still running on a worker, go out before their connection closes.
+    _connections.forEach([](ClientInfo& client) { client.read_paused = true; });
+    if (_connections.size() > 0)
+    {
+        LOG_INFO("Reactor %d draining %zu connections", _id, _connections.size());
+    }
+
+    _timers.schedule(static_cast<uint64_t>(_config.drain_timeout_seconds) * 1000,
+                     [this]() { _drain_expired = true; });
+    closeDrained();
+}
+
+void Reactor::closeDrained()
+{
+    _connections.forEach([this](ClientInfo& client)
+    {
+        if (client.lingering || client.job_pending || _io->pendingOutput(client) > 0)
+            return;
+
+        // All output is with the kernel: FIN goes out after it. Reading on until the peer
+        // closes keeps unread requests from turning the close into a reset, which would
+        // discard the replies still in flight.
+        if (shutdown(client.fd, SHUT_WR) < 0)
+        {
+            removeClient(client);
+            return;
+        }
+        client.lingering = true;
+        client.read_paused = false;
+        _io->resumeRead(client);
+    });
+}
+
+void Reactor::expireUdpPeers()
+{
+    size_t expired = _udp_peers.expire(_clock.ms());
+    if (expired > 0)
+    {
+        _metrics.udp_expired.add(expired);
+        _metrics.udp_peers.set(_udp_peers.size());
+    }
+
+    // A UDP subscription lasts as long as its peer is tracked.
+    if (_channels.subscriptions() > 0)
+    {
+        _channels.expireUdp([this](const UdpPeerKey& key) { return _udp_peers.contains(key); });
+        subscriptionsChanged();
+    }
+
+    armUdpExpiry();
+}
+
+void Reactor::armUdpExpiry()
+{
+    // An idle reactor has no timer at all and sleeps until the next event.
+    if (_udp_expiry_timer != 0 || _udp_peers.size() == 0)
+        return;
+
+    _udp_expiry_timer = _timers.schedule(UDP_EXPIRY_INTERVAL_MS, [this]()
+    {
+        _udp_expiry_timer = 0;
+        expireUdpPeers();
+    });
+}
+
+uint64_t Reactor::nextDeadline(const ClientInfo& client) const
+{
+    uint64_t next = UINT64_MAX;
+
+    // Read and write deadlines count only while a read or write is in progress; one that
+    // starts later brings the timer forward through updateDeadline(). Subscribers may
+    // wait quietly for messages as long as they like.
+    if (_config.idle_timeout_seconds > 0 && client.subscriptions.empty())
+    {
+        next = std::min<uint64_t>(next, client.last_activity_ms + _config.idle_timeout_seconds * 1000ull);
+    }
+    if (_config.read_timeout_seconds > 0 && client.read_started_ms != 0)
+    {
+        next = std::min<uint64_t>(next, client.read_started_ms + _config.read_timeout_seconds * 1000ull);
+    }
+    if (_config.write_timeout_seconds > 0 && client.write_started_ms != 0)
+    {
+        next = std::min<uint64_t>(next, client.write_started_ms + _config.write_timeout_seconds * 1000ull);
+    }
+
+    return next;
+}
+
+void Reactor::armDeadline(ClientInfo& client)
+{
+    client.deadline_timer = 0;
+    client.deadline_ms = nextDeadline(client);
+    if (client.deadline_ms == UINT64_MAX)
+        return;
+
+    uint64_t token = client.token();
+    uint64_t now = _clock.ms();
+    client.deadline_timer = _timers.schedule(client.deadline_ms > now ? client.deadline_ms - now : 0,
+                                             [this, token]() { checkDeadlines(token); });
+}
+
+void Reactor::updateDeadline(ClientInfo& client)
+{
+    if (nextDeadline(client) >= client.deadline_ms)
+        return;     // the timer fires early enough, and checkDeadlines() re-arms it
+
+    _timers.cancel(client.deadline_timer);
+    armDeadline(client);
+}
+
+void Reactor::checkDeadlines(uint64_t token)
+{
+    ClientInfo* client = _connections.resolve(token);
+    if (!client)
+        return;
+
+    client->deadline_timer = 0;
+
+    const char* reason = nullptr;
+    if (_config.idle_timeout_seconds > 0 && client->subscriptions.empty() &&
+        _clock.ms() - client->last_activity_ms >= _config.idle_timeout_seconds * 1000ull)
+    {
+        reason = "idle timeout";
+    }
+    else if (_config.read_timeout_seconds > 0 && client->read_started_ms != 0 &&
+             _clock.ms() - client->read_started_ms >= _config.read_timeout_seconds * 1000ull)
+    {
+        reason = "read timeout";
+    }
+    else if (_config.write_timeout_seconds > 0 && client->write_started_ms != 0 &&
+             _clock.ms() - client->write_started_ms >= _config.write_timeout_seconds * 1000ull)
+    {
+        reason = "write timeout";
+    }
+
+    if (reason)
+    {
+        LOG_INFO("Closing %s: %s", formatAddress(client->address).c_str(), reason);
+        removeClient(*client);
+        return;
+    }
+
+    armDeadline(*client);
+}
+
+ClientInfo* Reactor::acceptClient(int fd, const sockaddr_storage& addr, socklen_t addr_len, bool ktls)
+{
+    if (_draining)
+    {
+        // Completed by the kernel before listening stopped.
+        close(fd);
+        return nullptr;
+    }
+
+    if (_max_connections > 0 && _connections.size() >= _max_connections)
+    {
+        // Reset at once, before any per-connection state or logging: a storm of
+        // reconnects must cost the loop as little as possible.
+        linger reset{ 1, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        close(fd);
+        _metrics.rejected.add();
+        LOG_WARN("Connection limit reached on reactor %d (%zu), rejecting", _id, _max_connections);
+        return nullptr;
+    }
+
+    // Replies are already batched per input pass; Nagle would only delay the last one.
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    ClientInfo& client = _connections.acquire(fd, addr, addr_len, _clock.wallTime());
+    client.ktls = ktls;     // before addClient(): the backend picks its send flags by it
+
+    if (!_io->addClient(client))
+    {
+        _connections.release(client);
+        close(fd);
+        return nullptr;
+    }
+
+    _metrics.accepted.add();
+    _metrics.open_connections.set(_connections.size());
+
+    client.last_activity_ms = _clock.ms();
+    armDeadline(client);
+
+    LOG_INFO("New TCP connection from %s (fd: %d, reactor: %d)",
+             formatAddress(addr).c_str(), fd, _id);
+
+    return &client;
+}
+
+char* Reactor::receiveBuffer(ClientInfo& client, size_t& space)
+{
+    // A frame may carry a payload as long as a line, plus its header.
+    size_t limit = static_cast<size_t>(_config.max_line_length);
+    if (client.framing == ClientInfo::Framing::Frames)
+    {
+        limit += FrameHeader::SIZE;
+    }
+
+    if (!client.input.prepareWrite(_pool, limit))
+    {
+        sendResponse(&client, "Error: line too long");
+        removeClient(client);
+        return nullptr;
+    }
+
+    space = client.input.writable();
+    return client.input.writePtr();
+}
+
+void Reactor::onReceived(ClientInfo& client, size_t bytes)
+{
+    client.input.commit(bytes);
+    client.bytes_received += bytes;
+    _metrics.bytes_in.add(bytes);
+    client.last_activity_ms = _clock.ms();
+
+    if (client.lingering)
+    {
+        client.input.consume(client.input.pending());
+        return;
+    }
+
+    processInput(client);
+}
+
+void Reactor::processInput(ClientInfo& client)
+{
+    InputBuffer& input = client.input;
+    const size_t high_water = static_cast<size_t>(_config.write_high_water);
+
+    if (client.framing == ClientInfo::Framing::Unknown && input.pending() > 0)
+    {
+        // The magic byte cannot start a text line, so it picks binary framing for good.
+        if (static_cast<unsigned char>(input.unread()[0]) == FrameHeader::MAGIC)
+        {
+            client.framing = ClientInfo::Framing::Frames;
+            input.consume(1);
+        }
+        else
+        {
+            client.framing = ClientInfo::Framing::Lines;
+        }
+    }
+
+    // Replies to everything handled in this pass leave in one write at its end.
+    client.batching = true;
+
+    bool framing_error = false;
+    if (client.framing == ClientInfo::Framing::Frames)
+    {
+        framing_error = !processFrames(client, high_water);
+    }
+    else
+    {
+        std::string_view line;
+        while (!client.job_pending && _io->pendingOutput(client) < high_water && input.nextLine(line))
+        {
+            std::string_view message = line;
+            if (!message.empty() && message.back() == '\r')
+            {
+                message.remove_suffix(1);
+            }
+
+            if (_rate_limited && !message.empty())
+            {
+                Admission admission = admit(client, limitedCommand(message), nullptr);
+                if (admission == Admission::Wait)
+                {
+                    input.unget(line);
+                    break;
+                }
+                if (admission == Admission::Skip)
+                    continue;
+            }
+
+            processClientMessage(&client, message);
+        }
+    }
+
+    client.batching = false;
+    flushReplies(client);
+
+    if (client.write_failed || framing_error)
+    {
+        removeClient(client);
+        return;
+    }
+
+    if (client.job_pending || client.rate_timer != 0 || _io->pendingOutput(client) >= high_water)
+    {
+        // Slow consumer, a command still running on a worker, or a rate limit to wait
+        // for: leave further requests in the socket until the queue drains, the reply is
+        // queued or tokens are back, in order.
+        client.read_paused = true;
+        return;
+    }
+
+    if (input.pending() == 0)
+    {
+        // Idle connections hold no receive memory; queued echoes keep the chunk alive.
+        input.release();
+        client.read_started_ms = 0;
+    }
+    else if (client.read_started_ms == 0)
+    {
+        client.read_started_ms = _clock.ms();
+        updateDeadline(client);
+    }
+}
+
+bool Reactor::processFrames(ClientInfo& client, size_t high_water)
+{
+    // Lengths are known up front: a frame is handled once all of it is here, and no byte
+    // of it is ever scanned for a delimiter.
+    while (!client.job_pending && _io->pendingOutput(client) < high_water)
+    {
+        std::string_view unread = client.input.unread();
+        if (unread.size() < FrameHeader::SIZE)
+            break;
+
+        FrameHeader frame = FrameHeader::decode(unread.data());
+        if (frame.length > static_cast<uint32_t>(_config.max_line_length))
+        {
+            FrameHeader reply = frame;
+            reply.status = FrameHeader::STATUS_ERROR;
+            _current_frame = &reply;
+            sendResponse(&client, "Error: frame too long");
+            _current_frame = nullptr;
+            return false;
+        }
+
+        if (unread.size() - FrameHeader::SIZE < frame.length)
+            break;
+
+        std::string_view payload = unread.substr(FrameHeader::SIZE, frame.length);
+        if (_rate_limited)
+        {
+            Admission admission = admit(client, limitedCommand(frame, payload), &frame);
+            if (admission == Admission::Wait)
+                break;
+            if (admission == Admission::Skip)
+            {
+                client.input.consume(FrameHeader::SIZE + frame.length);
+                continue;
+            }
+        }
+
+        client.input.consume(FrameHeader::SIZE + frame.length);
+        processFrame(&client, frame, payload);
+    }
+
+    return true;
+}
+
+void Reactor::onSent(ClientInfo& client, size_t bytes)
+{
+    _metrics.tcp_writes.add();
+    _metrics.bytes_out.add(bytes);
+    client.bytes_sent += bytes;
+    client.last_activity_ms = client.write_started_ms = _clock.ms();
+
+    if (_io->pendingOutput(client) == 0)
+    {
+        client.write_started_ms = 0;
+    }
+}
+
+void Reactor::onWritable(ClientInfo& client)
+{
+    if (client.write_failed)
+    {
+        removeClient(client);
+        return;
+    }
+
+    // Resume reading once no command is running for the client and the backlog has fallen
+    // well below the high-water mark; a draining reactor reads nothing more.
+    if (client.read_paused && !client.job_pending && !_draining &&
+        _io->pendingOutput(client) < static_cast<size_t>(_config.write_high_water) / 2)
+    {
+        client.read_paused = false;
+        processInput(client);
+
+        if (client.active && !client.read_paused)
+        {
+            _io->resumeRead(client);
+        }
+    }
+}
+
+void Reactor::handleUdpData(int fd)
+{
+    _current_udp_socket = fd;
+
+    while (true)
+    {
+        int count = _udp_batch.receive(fd);
+        if (count <= 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            sockaddr_storage* client_addr = _udp_batch.peer(i);
+            std::string_view message = _udp_batch.payload(i);
+
+            bool inserted = false;
+            UdpPeer& peer = _udp_peers.touch(UdpPeerTable::makeKey(*client_addr), _clock.ms(), inserted);
+            peer.bytes_received += message.size();
+            _metrics.bytes_in.add(message.size());
+            ++peer.packets_received;
+
+            if (inserted)
+            {
+                _metrics.udp_peers_seen.add();
+                _metrics.udp_peers.set(_udp_peers.size());
+                _metrics.udp_evicted.set(_udp_peers.evicted());
+                armUdpExpiry();
+
+                if (Logger::instance().enabled(LogLevel::Info))
+                {
+                    LOG_INFO("New UDP client: %s", formatAddress(*client_addr).c_str());
+                }
+            }
+
+            _current_udp_peer = &peer;
+            if (!message.empty() && static_cast<unsigned char>(message[0]) == FrameHeader::MAGIC)
+            {
+                // One frame per datagram; a truncated or padded one is dropped.
+                message.remove_prefix(1);
+                if (message.size() >= FrameHeader::SIZE)
+                {
+                    FrameHeader frame = FrameHeader::decode(message.data());
+                    std::string_view payload = message.substr(FrameHeader::SIZE);
+                    if (payload.size() == frame.length &&
+                        (!_rate_limited || admitDatagram(peer, limitedCommand(frame, payload), &frame,
+                                                         client_addr, _udp_batch.peerLength(i))))
+                    {
+                        processFrame(nullptr, frame, payload, client_addr, _udp_batch.peerLength(i));
+                    }
+                }
+            }
+            else
+            {
+                while (!message.empty() && (message.back() == '\n' || message.back() == '\r'))
+                {
+                    message.remove_suffix(1);
+                }
+
+                if (!_rate_limited || message.empty() ||
+                    admitDatagram(peer, limitedCommand(message), nullptr, client_addr, _udp_batch.peerLength(i)))
+                {
+                    processClientMessage(nullptr, message, client_addr, _udp_batch.peerLength(i));
+                }
+            }
+            _current_udp_peer = nullptr;
+        }
+
+        // All replies produced by this batch leave in one sendmmsg().
+        _udp_batch.flush(fd);
+
+        // A short batch means the receive queue is empty; a new datagram re-arms the edge.
+        if (static_cast<size_t>(count) < _udp_batch.batchSize())
+        {
+            break;
+        }
+    }
+
+    _current_udp_socket = -1;
+}
+
+int Reactor::limitedCommand(std::string_view line) const
+{
+    if (_command_limits.empty() || line[0] != '/')
+        return -1;
+
+    std::string_view args;
+    int index = _server.commands().lookup(line, args);
+    return index >= 0 && _command_limits[index].limit.rate > 0 ? index : -1;
+}
+
+int Reactor::limitedCommand(const FrameHeader& frame, std::string_view payload) const
+{
+    if (_command_limits.empty())
+        return -1;
+
+    int index = -1;
+    if (frame.opcode == FrameHeader::OP_COMMAND && !payload.empty() && payload[0] == '/')
+    {
+        std::string_view args;
+        index = _server.commands().lookup(payload, args);
+    }
+    else if (frame.opcode >= FrameHeader::OP_COMMAND_BASE &&
+             frame.opcode - FrameHeader::OP_COMMAND_BASE < static_cast<int>(_command_limits.size()))
+    {
+        index = frame.opcode - FrameHeader::OP_COMMAND_BASE;
+    }
+    return index >= 0 && _command_limits[index].limit.rate > 0 ? index : -1;
+}
+
+uint64_t Reactor::throttle(TokenBucket& sender, const RateLimit& limit, ShardCounter& limited, int command)
+{
+    uint64_t wait = limit.rate > 0 ? sender.refill(_clock.ms(), limit) : 0;
+    if (wait > 0)
+    {
+        limited.add();
+        return wait;
+    }
+
+    if (command >= 0)
+    {
+        CommandLimit& shared = _command_limits[command];
+        wait = shared.bucket.refill(_clock.ms(), shared.limit);
+        if (wait > 0)
+        {
+            _metrics.limited_commands.add();
+            return wait;
+        }
+        shared.bucket.take();
+    }
+
+    if (limit.rate > 0)
+    {
+        sender.take();
+    }
+    return 0;
+}
+
+Reactor::Admission Reactor::admit(ClientInfo& client, int command, const FrameHeader* frame)
+{
+    uint64_t wait = throttle(client.rate_bucket, _client_limit, _metrics.limited_tcp, command);
+    if (wait == 0)
+        return Admission::Run;
+
+    switch (_rate_action)
+    {
+        case RateAction::Delay:
+        {
+            // TCP pushes back on the sender by itself while nothing is read.
+            if (client.rate_timer == 0)
+            {
+                uint64_t token = client.token();
+                client.rate_timer = _timers.schedule(wait, [this, token]()
+                {
+                    ClientInfo* waiting = _connections.resolve(token);
+                    if (waiting)
+                    {
+                        waiting->rate_timer = 0;
+                        onWritable(*waiting);
+                    }
+                });
+            }
+            return Admission::Wait;
+        }
+        case RateAction::Reject:
+            rejectMessage(&client, frame);
+            return Admission::Skip;
+        case RateAction::Drop:
+            break;
+    }
+    return Admission::Skip;
+}
+
+bool Reactor::admitDatagram(UdpPeer& peer, int command, const FrameHeader* frame,
+                            sockaddr_storage* udp_addr, socklen_t udp_addr_len)
+{
+    if (throttle(peer.rate_bucket, _udp_limit, _metrics.limited_udp, command) == 0)
+        return true;
+
+    // Datagrams cannot wait without a queue of their own; a delay drops them.
+    if (_rate_action == RateAction::Reject)
+    {
+        rejectMessage(nullptr, frame, udp_addr, udp_addr_len);
+    }
+    return false;
+}
+
+void Reactor::rejectMessage(ClientInfo* client, const FrameHeader* frame,
+                            sockaddr_storage* udp_addr, socklen_t udp_addr_len)
+{
+    FrameHeader reply;
+    if (frame)
+    {
+        reply = *frame;
+        reply.status = FrameHeader::STATUS_ERROR;
+        _current_frame = &reply;
+    }
+    sendResponse(client, "Error: rate limit exceeded", udp_addr, udp_addr_len);
+    _current_frame = nullptr;
+}
+
+void Reactor::processClientMessage(ClientInfo* client, std::string_view message,
+                                   sockaddr_storage* udp_addr, socklen_t udp_addr_len)
+{
+    if (message.empty()) return;
+
+    _metrics.messages.add();
+
+    if (message[0] != '/')
+    {
+        if (client)
+        {
+            echoLine(*client, message);
+        }
+        else
+        {
+            sendResponse(client, message, udp_addr, udp_addr_len);
+        }
+        return;
+    }
+
+    std::string_view args;
+    int index = _server.commands().lookup(message, args);
+    if (offloadCommand(client, udp_addr, udp_addr_len, index, args))
+        return;
+
+    runCommand(client, udp_addr, udp_addr_len, [&](CommandContext& context, ReplyWriter& reply)
+    {
+        return _server.commands().execute(context, message, reply);
+    });
+}
+
+void Reactor::processFrame(ClientInfo* client, const FrameHeader& frame, std::string_view payload,
+                           sockaddr_storage* udp_addr, socklen_t udp_addr_len)
+{
+    _metrics.messages.add();
+
+    FrameHeader reply = frame;
+    reply.status = FrameHeader::STATUS_OK;
+    _current_frame = &reply;
+
+    if (frame.opcode == FrameHeader::OP_ECHO)
+    {
+        if (client)
+        {
+            echoFrame(*client, reply, payload);
+        }
+        else
+        {
+            sendResponse(client, payload, udp_addr, udp_addr_len);
+        }
+    }
+    else if (frame.opcode == FrameHeader::OP_COMMAND)
+    {
+        std::string_view args;
+        int index = _server.commands().lookup(payload, args);
+        if (offloadCommand(client, udp_addr, udp_addr_len, index, args))
+        {
+            _current_frame = nullptr;
+            return;
+        }
+
+        runCommand(client, udp_addr, udp_addr_len, [&](CommandContext& context, ReplyWriter& out)
+        {
+            return _server.commands().execute(context, payload, out);
+        });
+    }
+    else if (frame.opcode >= FrameHeader::OP_COMMAND_BASE)
+    {
+        size_t index = frame.opcode - FrameHeader::OP_COMMAND_BASE;
+        if (index < _server.commands().size() &&
+            offloadCommand(client, udp_addr, udp_addr_len, static_cast<int>(index), payload))
+        {
+            _current_frame = nullptr;
+            return;
+        }
+
+        runCommand(client, udp_addr, udp_addr_len, [&](CommandContext& context, ReplyWriter& out)
+        {
+            return _server.commands().execute(context, index, payload, out);
+        });
+    }
+    else
+    {
+        reply.status = FrameHeader::STATUS_ERROR;
+        writeResponse(client, udp_addr, udp_addr_len, [&](ReplyWriter& out)
+        {
+            out << "Unknown opcode: " << static_cast<unsigned>(frame.opcode);
+        });
+    }
+
+    _current_frame = nullptr;
+}
+
+bool Reactor::offloadCommand(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len,
+                             int index, std::string_view args)
+{
+    WorkerPool* workers = _server.workers();
+    if (index < 0 || !workers || !_server.commands().offloaded(static_cast<size_t>(index)))
+        return false;
+
+    _metrics.commands.add();
+    _metrics.offloaded.add();
+
+    // The input the arguments point into may be reused before the worker runs.
+    auto command = std::make_unique<OffloadedCommand>();
+    command->index = static_cast<size_t>(index);
+    command->args = std::string(args);
+    command->start = std::chrono::steady_clock::now();
+    if (_current_frame)
+    {
+        command->framed = true;
+        command->frame = *_current_frame;
+    }
+
+    if (client)
+    {
+        command->token = client->token();
+        client->job_pending = true;
+    }
+    else
+    {
+        command->udp_addr = *udp_addr;
+        command->udp_addr_len = udp_addr_len;
+        command->udp_socket = _current_udp_socket;
+    }
+
+    const CommandRegistry& commands = _server.commands();
+    workers->submit([this, &commands, command = command.release()]()
+    {
+        ReplyWriter reply(command->reply);
+        command->result = commands.executeOffloaded(command->index, command->args, reply);
+        completeCommand(command);
+    });
+
+    return true;
+}
+
+void Reactor::completeCommand(OffloadedCommand* command)
+{
+    if (_completions.push(command))
+    {
+        wake();
+    }
+}
+
+void Reactor::handleWakeup()
+{
+    uint64_t count;
+    while (read(_wake_fd, &count, sizeof(count)) > 0)
+    {
+    }
+
+    OffloadedCommand* command = _completions.takeAll();
+    while (command)
+    {
+        std::unique_ptr<OffloadedCommand> done(command);
+        command = command->next;
+        finishCommand(*done);
+    }
+
+    // A draining reactor sends nothing new.
+    PublicationDelivery* delivery = _publications.takeAll();
+    while (delivery)
+    {
+        std::unique_ptr<PublicationDelivery> done(delivery);
+        delivery = delivery->next;
+        if (!_draining)
+        {
+            fanOut(*done->publication);
+        }
+    }
+
+    AdoptedClient* adopted = _adopted.takeAll();
+    while (adopted)
+    {
+        std::unique_ptr<AdoptedClient> done(adopted);
+        adopted = adopted->next;
+        acceptClient(done->fd, done->addr, done->addr_len, true);
+    }
+}
+
+void Reactor::handleSignal()
+{
+    signalfd_siginfo info;
+    while (read(_signal_fd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info)))
+    {
+        LOG_INFO("Received signal %u, shutting down...", info.ssi_signo);
+        _server.shutdown();
+    }
+}
+
+void Reactor::finishCommand(OffloadedCommand& command)
+{
+    if (command.result >= 0 && static_cast<size_t>(command.result) < MetricsShard::MAX_TIMED_COMMANDS)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - command.start;
+        _metrics.command_ns[command.result].observe(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    if (command.framed)
+    {
+        command.frame.status = command.result < 0 ? FrameHeader::STATUS_ERROR : FrameHeader::STATUS_OK;
+        _current_frame = &command.frame;
+    }
+
+    if (command.token == 0)
+    {
+        sendResponse(nullptr, command.reply, &command.udp_addr, command.udp_addr_len);
+        _udp_batch.flush(command.udp_socket);     // from the socket the request came in on
+        _current_frame = nullptr;
+        return;
+    }
+
+    // The connection may have closed meanwhile; then the generation no longer matches.
+    ClientInfo* client = _connections.resolve(command.token);
+    if (client)
+    {
+        client->job_pending = false;
+        sendResponse(client, command.reply);
+    }
+    _current_frame = nullptr;
+
+    if (client)
+    {
+        onWritable(*client);    // picks up the input that waited for this reply
+    }
+}
+
+ChannelTable::Result Reactor::subscribe(const CommandContext& context, std::string_view channel)
+{
+    ChannelTable::Result result;
+    if (context.client)
+    {
+        result = _channels.subscribe(channel, context.client->token(), context.client->subscriptions);
+    }
+    else
+    {
+        const sockaddr_storage& addr = *context.udp_peer;
+        socklen_t addr_len = addr.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+        result = _channels.subscribe(channel, UdpPeerTable::makeKey(addr), addr, addr_len,
+                                     _current_udp_socket, _current_frame != nullptr);
+    }
+
+    if (result == ChannelTable::Result::Added)
+    {
+        sweepChannel(_channels.find(channel));
+        subscriptionsChanged();
+    }
+    return result;
+}
+
+size_t Reactor::unsubscribe(const CommandContext& context, std::string_view channel)
+{
+    size_t count = context.client ? _channels.unsubscribe(context.client->subscriptions, channel)
+                                   : _channels.unsubscribe(UdpPeerTable::makeKey(*context.udp_peer), channel);
+    if (count > 0)
+    {
+        subscriptionsChanged();
+        if (context.client && context.client->subscriptions.empty())
+        {
+            updateDeadline(*context.client);    // the idle timeout applies again
+        }
+    }
+    return count;
+}
+
+void Reactor::publish(std::string_view channel, std::string_view message)
+{
+    // Every reactor, this one included, gets the publication through its queue, so
+    // subscribers never see it in the middle of the publisher's reply.
+    _server.publish(std::make_shared<const Publication>(Publication{ std::string(channel), std::string(message) }));
+}
+
+void Reactor::adoptClient(int fd, const sockaddr_storage& addr, socklen_t addr_len)
+{
+    if (_adopted.push(new AdoptedClient{ nullptr, fd, addr, addr_len }))
+    {
+        wake();
+    }
+}
+
+void Reactor::deliver(const std::shared_ptr<const Publication>& publication)
+{
+    if (_publications.push(new PublicationDelivery{ nullptr, publication }))
+    {
+        wake();
+    }
+}
+
+void Reactor::subscriptionsChanged()
+{
+    _subscriber_count.store(_channels.subscriptions(), std::memory_order_relaxed);
+    _metrics.subscriptions.set(_channels.subscriptions());
+}
+
+bool Reactor::liveSubscriber(uint32_t id, const ChannelTable::TcpSubscriber& subscriber)
+{
+    ClientInfo* client = _connections.resolve(subscriber.token);
+    return client && ChannelTable::contains(client->subscriptions, id, subscriber.serial);
+}
+
+bool Reactor::liveSubscriber(uint32_t id, const ChannelTable::UdpSubscriber& subscriber) const
+{
+    const ChannelTable::UdpPeerSubscriptions* peer = _channels.udpPeer(subscriber.key);
+    return peer && ChannelTable::contains(peer->subscriptions, id, subscriber.serial);
+}
+
+void Reactor::sweepChannel(uint32_t id)
+{
+    if (!_channels.needsSweep(id))
+        return;
+
+    _channels.forEach(id,
+        [this, id](const ChannelTable::TcpSubscriber& subscriber) { return liveSubscriber(id, subscriber); },
+        [this, id](const ChannelTable::UdpSubscriber& subscriber) { return liveSubscriber(id, subscriber); });
+}
+
+void Reactor::encodePublication(const Publication& publication, bool framed, EncodedMessage& encoded)
+{
+    static constexpr std::string_view LINE_PREFIX = "message ";
+
+    size_t payload = publication.channel.size() + 1 + publication.message.size();
+    size_t size = framed ? FrameHeader::SIZE + payload : LINE_PREFIX.size() + payload + 1;
+
+    if (_publish_chunk && !_publish_chunk.shared())
+    {
+        _publish_used = 0;
+    }
+    if (_publish_used + size > _publish_chunk.capacity())
+    {
+        _publish_chunk = _pool.acquire(size);
+        _publish_used = 0;
+    }
+
+    char* out = _publish_chunk.data() + _publish_used;
+    char* p = out;
+    if (framed)
+    {
+        FrameHeader header;
+        header.length = static_cast<uint32_t>(payload);
+        header.opcode = FrameHeader::OP_MESSAGE;
+        header.status = FrameHeader::STATUS_OK;
+        header.encode(p);
+        p += FrameHeader::SIZE;
+    }
+    else
+    {
+        p = std::copy(LINE_PREFIX.begin(), LINE_PREFIX.end(), p);
+    }
+    p = std::copy(publication.channel.begin(), publication.channel.end(), p);
+    *p++ = ' ';
+    p = std::copy(publication.message.begin(), publication.message.end(), p);
+    if (!framed)
+    {
+        *p++ = '\n';
+    }
+
+    encoded.chunk = _publish_chunk;
+    encoded.data = out;
+    encoded.size = size;
+    _publish_used += size;
+}
+
+void Reactor::fanOut(const Publication& publication)
+{
+    uint32_t id = _channels.find(publication.channel);
+    if (id == ChannelTable::NONE)
+        return;
+
+    const size_t high_water = static_cast<size_t>(_config.write_high_water);
+    EncodedMessage line;
+    EncodedMessage frame;
+
+    // UDP copies of the message are datagrams pointing at one copy in the batch buffer;
+    // each flush empties that buffer, so the copy is made again after one.
+    static constexpr size_t NOT_QUEUED = SIZE_MAX;
+    int udp_socket = -1;
+    size_t udp_offset[2] = { NOT_QUEUED, NOT_QUEUED };
+    size_t udp_size[2] = { 0, 0 };
+
+    _channels.forEach(id,
+        [&](const ChannelTable::TcpSubscriber& subscriber)
+        {
+            ClientInfo* subscribed = _connections.resolve(subscriber.token);
+            if (!subscribed || !ChannelTable::contains(subscribed->subscriptions, id, subscriber.serial))
+                return false;
+
+            ClientInfo& client = *subscribed;
+            if (client.write_failed || client.lingering)
+                return true;
+
+            // A subscriber that cannot keep up must not make the publisher's reactor
+            // buffer without bound.
+            if (_io->pendingOutput(client) >= high_water)
+            {
+                _metrics.pubsub_dropped.add();
+                if (_slow_subscriber == SlowSubscriber::Disconnect)
+                {
+                    LOG_WARN("Disconnecting slow subscriber %s (fd: %d)",
+                             formatAddress(client.address).c_str(), client.fd);
+                    removeClient(client);
+                    return false;
+                }
+                return true;
+            }
+
+            bool framed = client.framing == ClientInfo::Framing::Frames;
+            EncodedMessage& encoded = framed ? frame : line;
+            if (!encoded.data)
+            {
+                encodePublication(publication, framed, encoded);
+            }
+
+            beginReply(client);
+            client.output.appendShared(encoded.chunk, encoded.data, encoded.size);
+            endReply(client);
+            _metrics.pubsub_delivered.add();
+
+            if (client.write_failed)
+            {
+                removeClient(client);
+                return false;
+            }
+            return true;
+        },
+        [&](const ChannelTable::UdpSubscriber& subscriber)
+        {
+            const ChannelTable::UdpPeerSubscriptions* peer = _channels.udpPeer(subscriber.key);
+            if (!peer || !ChannelTable::contains(peer->subscriptions, id, subscriber.serial))
+                return false;
+
+            if (peer->socket != udp_socket || _udp_batch.queued() >= _udp_batch.batchSize())
+            {
+                if (udp_socket >= 0)
+                {
+                    _udp_batch.flush(udp_socket);
+                }
+                udp_socket = peer->socket;
+                udp_offset[0] = udp_offset[1] = NOT_QUEUED;
+            }
+
+            int form = peer->framed ? 1 : 0;
+            if (udp_offset[form] == NOT_QUEUED)
+            {
+                EncodedMessage& encoded = peer->framed ? frame : line;
+                if (!encoded.data)
+                {
+                    encodePublication(publication, peer->framed, encoded);
+                }
+
+                std::string& out = _udp_batch.replyBuffer();
+                udp_offset[form] = out.size();
+                if (peer->framed)
+                {
+                    out.push_back(static_cast<char>(FrameHeader::MAGIC));
+                }
+                out.append(encoded.data, encoded.size);
+                udp_size[form] = out.size() - udp_offset[form];
+            }
+
+            _udp_batch.queueRepeat(peer->addr, peer->addr_len, udp_offset[form], udp_size[form]);
+            _metrics.bytes_out.add(udp_size[form]);
+            _metrics.pubsub_delivered.add();
+            return true;
+        });
+
+    if (udp_socket >= 0)
+    {
+        _udp_batch.flush(udp_socket);
+    }
+}
+
+template <typename Execute>
+void Reactor::runCommand(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len, Execute&& execute)
+{
+    _metrics.commands.add();
+
+    CommandContext context{ *this, client, udp_addr };
+    auto start = std::chrono::steady_clock::now();
+    int index = -1;
+    writeResponse(client, udp_addr, udp_addr_len, [&](ReplyWriter& reply)
+    {
+        index = execute(context, reply);
+        if (index < 0 && _current_frame)
+        {
+            _current_frame->status = FrameHeader::STATUS_ERROR;
+        }
+    });
+
+    if (index >= 0 && static_cast<size_t>(index) < MetricsShard::MAX_TIMED_COMMANDS)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        _metrics.command_ns[index].observe(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+}
+
+void Reactor::sendResponse(ClientInfo* client, std::string_view response,
+                           sockaddr_storage* udp_addr, socklen_t udp_addr_len)
+{
+    writeResponse(client, udp_addr, udp_addr_len, [response](ReplyWriter& reply) { reply << response; });
+}
+
+template <typename Write>
+void Reactor::writeResponse(ClientInfo* client, sockaddr_storage* udp_addr, socklen_t udp_addr_len, Write&& write)
+{
+    if (!client && udp_addr)
+    {
+        std::string& out = _udp_batch.replyBuffer();
+        size_t offset = out.size();
+        if (_current_frame)
+        {
+            out.push_back(static_cast<char>(FrameHeader::MAGIC));
+            out.append(FrameHeader::SIZE, '\0');
+        }
+        ReplyWriter reply(out);
+        write(reply);
+        if (_current_frame)
+        {
+            _current_frame->length = static_cast<uint32_t>(reply.written());
+            _current_frame->encode(&out[offset + 1]);
+        }
+        _udp_batch.commitReply(*udp_addr, udp_addr_len, offset, !_current_frame);
+        _metrics.bytes_out.add(out.size() - offset);
+
+        if (_current_udp_peer)
+        {
+            _current_udp_peer->bytes_sent += out.size() - offset;
+            ++_current_udp_peer->packets_sent;
+        }
+    }
+    else if (client && !client->write_failed)
+    {
+        beginReply(*client);
+        std::string& out = client->output.appendTarget();
+        size_t offset = out.size();
+        if (_current_frame)
+        {
+            // The header goes first and is filled in once the length is known.
+            out.append(FrameHeader::SIZE, '\0');
+        }
+        ReplyWriter reply(out);
+        write(reply);
+        if (_current_frame)
+        {
+            _current_frame->length = static_cast<uint32_t>(reply.written());
+            _current_frame->encode(&out[offset]);
+        }
+        else
+        {
+            reply << '\n';
+        }
+        endReply(*client);
+    }
+}
+
+void Reactor::echoLine(ClientInfo& client, std::string_view line)
+{
+    if (client.write_failed)
+        return;
+
+    // The line still sits in the input chunk, followed by its '\n' unless a '\r' was
+    // stripped before it: queue it by reference rather than copying it.
+    bool newline = line.data()[line.size()] == '\n';
+
+    beginReply(client);
+    client.output.appendShared(client.input.chunk(), line.data(), line.size() + (newline ? 1 : 0));
+    if (!newline)
+    {
+        client.output.append('\n');
+    }
+    endReply(client);
+}
+
+void Reactor::echoFrame(ClientInfo& client, const FrameHeader& request, std::string_view payload)
+{
+    if (client.write_failed)
+        return;
+
+    FrameHeader reply = request;
+    reply.status = FrameHeader::STATUS_OK;
+    char header[FrameHeader::SIZE];
+    reply.encode(header);
+
+    // Like a line, the payload is queued by reference to the input chunk.
+    beginReply(client);
+    client.output.append(std::string_view(header, sizeof(header)));
+    client.output.appendShared(client.input.chunk(), payload.data(), payload.size());
+    endReply(client);
+}
+
+void Reactor::beginReply(ClientInfo& client)
+{
+    if (_io->pendingOutput(client) == 0)
+    {
+        client.write_started_ms = _clock.ms();
+        updateDeadline(client);
+    }
+}
+
+void Reactor::endReply(ClientInfo& client)
+{
+    _metrics.tcp_responses.add();
+
+    if (!client.batching)
+    {
+        flushReplies(client);
+    }
+}
+
+void Reactor::flushReplies(ClientInfo& client)
+{
+    _metrics.queue_depth.observe(_io->pendingOutput(client));
+
+    // While a write is outstanding the socket is known to be full (epoll) or the
+    // kernel still owns the previous bytes (io_uring); the data just waits its turn.
+    if (!client.want_write && !client.write_failed)
+    {
+        _io->flush(client);
+    }
+}
+
+void Reactor::removeClient(ClientInfo& client)
+{
+    if (!client.active)
+        return;
+
+    LOG_INFO("Client disconnected: %s (fd: %d)", formatAddress(client.address).c_str(), client.fd);
+
+    _io->removeClient(client);
+    close(client.fd);
+
+    _timers.cancel(client.deadline_timer);
+    _timers.cancel(client.rate_timer);
+    if (!client.subscriptions.empty())
+    {
+        _channels.unsubscribe(client.subscriptions, {});
+        subscriptionsChanged();
+    }
+    _connections.release(client);
+    _metrics.closed.add();
+    _metrics.open_connections.set(_connections.size());
+}
+
+void Reactor::closeAll()
+{
+    _connections.forEach([this](ClientInfo& client)
+    {
+        close(client.fd);
+        _connections.release(client);
+    });
+    _metrics.open_connections.set(0);
+
+    for (int sock : _tcp_sockets)
+    {
+        close(sock);
+    }
+    _tcp_sockets.clear();
+
+    for (int sock : _udp_sockets)
+    {
+        close(sock);
+    }
+    _udp_sockets.clear();
+}
@@ -1,203 +1,164 @@
 #include "../include/server.hpp"
+#include "../include/logger.hpp"
+#include "../include/cpu_affinity.hpp"
 #include <iostream>
 #include <csignal>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <sys/epoll.h>
-#include <fcntl.h>
-#include <array>
-#include <arpa/inet.h>
-#include <sstream>
-#include <iomanip>
-
-NetworkServer* g_server_instance{ nullptr }; //global server instance for signal handling
-
-void signalHandler(int signum)
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <thread>
+#include <ctime>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace
 {
-    if (g_server_instance) 
-    {
-        std::cout << "\n[INFO] Received signal " << signum << ", shutting down..." << std::endl;
-        g_server_instance->shutdown();
-    }
-}
 
-NetworkServer::NetworkServer(int tcp_port, int udp_port)
-    :   _tcp_port{ tcp_port }, _udp_port{ udp_port },
-        _tcp_socket{ -1 }, _udp_socket{ -1 }, _epoll_fd{ -1 },
-        _total_connections{ 0 }, _current_connections{ 0 },
-        _running{ false }, _start_time{ std::chrono::system_clock::now() }
+// Store shards per reactor thread: enough that two reactors rarely want the same lock.
+constexpr size_t KV_SHARDS_PER_THREAD = 8;
+constexpr uint64_t KV_EXPIRY_INTERVAL_MS = 100;
+constexpr int64_t KV_MAX_TTL_SECONDS = 10LL * 365 * 24 * 3600;
+constexpr int64_t SLEEP_MAX_MS = 10000;
+
+} // namespace
+
+NetworkServer::NetworkServer(const ServerConfig& config)
+    :   _config{ config },
+        _store{ static_cast<size_t>(std::max(config.threads, 1)) * KV_SHARDS_PER_THREAD },
+        _start_time{ std::chrono::system_clock::now() },
+        _running{ false }
 {
-    g_server_instance = this;
+    registerBuiltinCommands();
 }
 
 NetworkServer::~NetworkServer()
 {
     shutdown();
-    g_server_instance = nullptr;
-}
 
-bool NetworkServer::initialize()
-{
-    std::cout << "[INFO] Initializing network server..." << std::endl;
+    // Everything that may still log goes before the logger: the TLS acceptor and the
+    // metrics endpoint, then the worker pool, whose tasks complete into the reactors, then
+    // the reactors, which close their connections.
+    _tls.reset();
+    _metrics_http.reset();
+    _workers.reset();
+    _reactors.clear();
 
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
-    signal(SIGPIPE, SIG_IGN);
-
-    _tcp_socket = createTcpSocket();
-    if (_tcp_socket < 0)
+    if (_signal_fd >= 0)
     {
-        std::cerr << "[ERROR] Failed to create TCP socket." << std::endl;
-        return false;
+        close(_signal_fd);
     }
+    Logger::instance().stop();
+}
 
-    _udp_socket = createUdpSocket();
-    if (_udp_socket < 0)
-    {
-        std::cerr << "[ERROR] Failed to create UDP socket." << std::endl;
+bool NetworkServer::initialize()
+{
+    // Blocked before the first thread starts, so that every thread inherits the mask and
+    // the signals only ever show up on the signalfd.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    _signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (_signal_fd < 0)
+    {
+        perror("signalfd");
         return false;
     }
 
-    if (!setupEpoll())
+    LogLevel level = LogLevel::Info;
+    parseLogLevel(_config.log_level, level);
+    if (!Logger::instance().start(_config.log_file, level, static_cast<uint32_t>(_config.log_rate_limit)))
     {
-        std::cerr << "[ERROR] Failed to setup epoll." << std::endl;
+        std::cerr << "[ERROR] Failed to open log file " << _config.log_file << std::endl;
         return false;
     }
 
-    std::cout << "[INFO] Server initialized successfully" << std::endl;
-    std::cout << "[INFO] TCP listening on port " << _tcp_port << std::endl;
-    std::cout << "[INFO] UDP listening on port " << _udp_port << std::endl;
-    
-    return true;
-}
+    LOG_INFO("Initializing network server...");
 
-int NetworkServer::createTcpSocket()
-{
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
-    {
-        perror("socket");
-        return -1;
-    }
+    signal(SIGPIPE, SIG_IGN);
 
-    int opt = 1;
-    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)))
+    for (const auto& [name, rate] : _config.command_rates)
     {
-        perror("setsockopt SO_REUSEADDR");
-        close(sock);
-        return -1;
+        if (!_commands.setRateLimit(name, static_cast<uint32_t>(rate)))
+        {
+            std::cerr << "[ERROR] --command-rate: unknown command " << name << std::endl;
+            return false;
+        }
     }
 
-    if (!setNonBlocking(sock))
+    if (_config.worker_threads > 0)
     {
-        close(sock);
-        return -1;
+        _workers = std::make_unique<WorkerPool>(static_cast<size_t>(_config.worker_threads));
     }
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(_tcp_port);
-
-    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+    for (int i = 0; i < _config.threads; ++i)
     {
-        perror("bind TCP");
-        close(sock);
-        return -1;
-    }
+        // What the reactor sets up here (tables, batch buffers, rings) comes from the NUMA
+        // node of the CPU it will run on; the rest is faulted in there once it runs pinned.
+        int cpu = _config.cpus.empty() ? -1 : _config.cpus[static_cast<size_t>(i) % _config.cpus.size()];
+        PreferredNode node(cpu >= 0 ? cpuNode(cpu) : -1);
 
-    if (listen(sock, SOMAXCONN) < 0)
-    {
-        perror("listen");
-        close(sock);
-        return -1;
+        auto reactor = std::make_unique<Reactor>(*this, _config, i);
+        if (!reactor->initialize(i == 0 ? _signal_fd : -1))
+        {
+            std::cerr << "[ERROR] Failed to initialize reactor " << i << std::endl;
+            return false;
+        }
+        _reactors.push_back(std::move(reactor));
     }
 
-    return sock;
-}
-
-int NetworkServer::createUdpSocket()
-{
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0)
+    if (_config.metrics_port > 0)
     {
-        perror("socket UDP");
-        return -1;
+        _metrics_http = std::make_unique<MetricsHttpServer>(*this);
+        if (!_metrics_http->listen(_config.metrics_port))
+        {
+            std::cerr << "[ERROR] Failed to open the metrics port " << _config.metrics_port << std::endl;
+            return false;
+        }
     }
 
-    int opt = 1;
-    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    if (_config.tls_port > 0)
     {
-        perror("setsockopt SO_REUSEADDR UDP");
-        close(sock);
-        return -1;
+        _tls = std::make_unique<TlsAcceptor>(_config, _reactors);
+        if (!_tls->listen())
+            return false;
     }
 
-    if (!setNonBlocking(sock))
+    LOG_INFO("Server initialized successfully");
+    for (const Endpoint& endpoint : listenEndpoints(_config.tcp_listen, _config.tcp_port))
     {
-        close(sock);
-        return -1;
+        LOG_INFO("TCP listening on %s", formatAddress(endpoint.addr).c_str());
     }
-
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(_udp_port);
-
-    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+    for (const Endpoint& endpoint : listenEndpoints(_config.udp_listen, _config.udp_port))
     {
-        perror("bind UDP");
-        close(sock);
-        return -1;
+        LOG_INFO("UDP listening on %s", formatAddress(endpoint.addr).c_str());
     }
-
-    return sock;
-}
-
-bool NetworkServer::setupEpoll()
-{
-    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-    if (_epoll_fd < 0)
+    if (_tls)
     {
-        perror("epoll_create1");
-        return false;
+        LOG_INFO("TLS listening on [::]:%d (kernel TLS)", _config.tls_port);
     }
-
-    epoll_event event{};
-    event.events = EPOLLIN | EPOLLET;
-    event.data.fd = _tcp_socket;
-
-    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _tcp_socket, &event) < 0)
+    if (_metrics_http)
     {
-        perror("epoll_ctl TCP");
-        return false;
+        LOG_INFO("Metrics on http://127.0.0.1:%d/metrics", _config.metrics_port);
     }
-
-    event.events = EPOLLIN | EPOLLET;
-    event.data.fd = _udp_socket;
-
-    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _udp_socket, &event) < 0)
+    LOG_INFO("Reactor threads: %zu, worker threads: %zu", _reactors.size(), _workers ? _workers->size() : 0);
+    if (_config.low_latency)
     {
-        perror("epoll_ctl UDP");
-        return false;
+        LOG_INFO("Low-latency mode: busy polling for %d us before blocking", _config.busy_poll_usec);
     }
+    LOG_INFO("UDP batch size: %d (GSO %s)", _config.udp_batch,
+             _reactors[0]->udpGsoEnabled() ? "enabled" : "unavailable");
 
-    return true;
-}
-
-bool NetworkServer::setNonBlocking(int fd)
-{
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags < 0)
+    const char* backend = _reactors[0]->ioBackendName();
+    if (_config.io_backend != "epoll" && std::strcmp(backend, "epoll") == 0)
     {
-        perror("fcntl F_GETFL");
-        return false;
+        LOG_WARN("I/O backend: epoll (io_uring is unavailable on this kernel)");
     }
-
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    else
     {
-        perror("fcntl F_SETFL");
-        return false;
+        LOG_INFO("I/O backend: %s", backend);
     }
 
     return true;
@@ -206,346 +167,496 @@ bool NetworkServer::setNonBlocking(int fd)
 void NetworkServer::run()
 {
     _running = true;
-    std::array<epoll_event, MAX_EVENTS> events;
 
-    std::cout << "[INFO] Server is running. Press Ctrl+C to stop." << std::endl;
+    LOG_INFO("Server is running. Press Ctrl+C to stop.");
 
-    while (_running)
+    if (_metrics_http)
     {
-        int nfds = epoll_wait(_epoll_fd, events.data(), MAX_EVENTS, 100);
-
-        if (nfds < 0)
-        {
-            if (errno == EINTR)
-                continue;
-            perror("epoll_wain");
-            break;
-        }
-
-        for (int i = 0; i < nfds; ++i)
-        {
-            if (events[i].data.fd == _tcp_socket)
-            {
-                handleTcpConnection();
-            }
-            else if (events[i].data.fd == _udp_socket)
-            {
-                handleUdpData();
-            }
-            else
-            {
-                if (events[i].events & (EPOLLHUP | EPOLLERR))
-                {
-                    removeClient(events[i].data.fd);
-                }
-                else if (events[i].events & EPOLLIN)
-                {
-                    handleTcpData(events[i].data.fd);
-                }
-            }
-        }
+        _metrics_http->start();
     }
-
-    std::cout << "[INFO] Server stopped" << std::endl;
-}
-
-void NetworkServer::handleTcpConnection()
-{
-    while (true)
+    if (_tls)
     {
-        sockaddr_in client_addr{};
-        socklen_t addr_len = sizeof(client_addr);
+        _tls->start();
+    }
 
-        int client_fd = accept(_tcp_socket, (sockaddr*)&client_addr, &addr_len);
-        if (client_fd < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) 
-            {
-                break;  // No more pending connections
-            }
-            perror("accept");
-            continue;
-        }
+    // Reactor 0 runs on the calling thread, the rest get a thread each.
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < _reactors.size(); ++i)
+    {
+        threads.emplace_back([reactor = _reactors[i].get()]() { reactor->run(); });
+    }
 
-        if (!setNonBlocking(client_fd))
-        {
-            close(client_fd);
-            continue;
-        }
+    if (!_reactors.empty())
+    {
+        _reactors[0]->run();
+    }
 
-        epoll_event event{};
-        event.events = EPOLLIN | EPOLLET | EPOLLHUP | EPOLLERR;
-        event.data.fd = client_fd;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    if (_tls)
+    {
+        _tls->join();
+    }
+    if (_metrics_http)
+    {
+        _metrics_http->join();
+    }
 
-        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0)
-        {
-            perror("epoll_ctl client");
-            close(client_fd);
-            continue;
-        }
+    LOG_INFO("Server stopped");
+}
 
-        std::string client_ip = inet_ntoa(client_addr.sin_addr);
-        uint16_t client_port = ntohs(client_addr.sin_port);
+bool NetworkServer::registerCommand(std::string_view name, const CommandSpec& spec, CommandHandler handler)
+{
+    return _commands.add(name, spec, std::move(handler));
+}
 
-        _clients[client_fd] = std::make_unique<ClientInfo>(client_ip, client_port);
-        ++_total_connections;
-        ++_current_connections;
+bool NetworkServer::registerOffloadedCommand(std::string_view name, const CommandSpec& spec, OffloadedHandler handler)
+{
+    return _commands.addOffloaded(name, spec, std::move(handler));
+}
 
-        std::cout << "[INFO] New TCP connection from " << client_ip << ":" << client_port 
-                  << " (fd: " << client_fd << ")" << std::endl;
-    }
+void NetworkServer::registerBuiltinCommands()
+{
+    registerCommand("/time", CommandSpec{},
+                    [](CommandContext& context, const CommandArgs&, ReplyWriter& reply)
+                    {
+                        reply << context.reactor.clock().localTime();
+                    });
+
+    registerCommand("/stats", CommandSpec{},
+                    [this](CommandContext&, const CommandArgs&, ReplyWriter& reply) { writeStats(reply); });
+
+    registerCommand("/shutdown", CommandSpec{},
+                    [this](CommandContext&, const CommandArgs&, ReplyWriter& reply)
+                    {
+                        reply << "The server is shutting down...";
+                        shutdown();
+                    });
+
+    CommandSpec subscribe;
+    subscribe.min_args = 1;
+    subscribe.max_args = 1;
+    subscribe.usage = "/subscribe <channel>";
+    registerCommand("/subscribe", subscribe,
+                    [](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        if (context.reactor.subscribe(context, args[0]) == ChannelTable::Result::Full)
+                        {
+                            reply << "Error: at most " << ChannelTable::MAX_SUBSCRIPTIONS << " subscriptions";
+                            return;
+                        }
+                        reply << "Subscribed to " << args[0];
+                    });
+
+    CommandSpec unsubscribe;
+    unsubscribe.max_args = 1;
+    unsubscribe.usage = "/unsubscribe [channel]";
+    registerCommand("/unsubscribe", unsubscribe,
+                    [](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        std::string_view channel = args.size() > 0 ? args[0] : std::string_view();
+                        size_t count = context.reactor.unsubscribe(context, channel);
+                        if (!channel.empty())
+                        {
+                            reply << (count > 0 ? "Unsubscribed from " : "Not subscribed to ") << channel;
+                            return;
+                        }
+                        reply << "Unsubscribed from " << count << (count == 1 ? " channel" : " channels");
+                    });
+
+    CommandSpec publish;
+    publish.min_args = 2;
+    publish.max_args = 2;
+    publish.rest = true;
+    publish.usage = "/publish <channel> <message>";
+    registerCommand("/publish", publish,
+                    [](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        context.reactor.publish(args[0], args[1]);
+                        reply << "Published to " << args[0];
+                    });
+
+    CommandSpec set;
+    set.min_args = 2;
+    set.max_args = 2;
+    set.rest = true;
+    set.usage = "/set <key> <value>";
+    registerCommand("/set", set,
+                    [this](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        _store.set(args[0], args[1], context.reactor.clock().ms());
+                        reply << "OK";
+                    });
+
+    CommandSpec get;
+    get.min_args = 1;
+    get.max_args = 1;
+    get.usage = "/get <key>";
+    registerCommand("/get", get,
+                    [this](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        if (!_store.get(args[0], context.reactor.clock().ms(),
+                                        [&reply](std::string_view value) { reply << value; }))
+                        {
+                            reply << "(nil)";
+                        }
+                    });
+
+    CommandSpec del;
+    del.min_args = 1;
+    del.max_args = CommandArgs::MAX_ARGS;
+    del.usage = "/del <key> [key...]";
+    registerCommand("/del", del,
+                    [this](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        size_t count = 0;
+                        for (size_t i = 0; i < args.size(); ++i)
+                        {
+                            count += _store.del(args[i], context.reactor.clock().ms()) ? 1 : 0;
+                        }
+                        reply << count;
+                    });
+
+    CommandSpec incr;
+    incr.min_args = 1;
+    incr.max_args = 2;
+    incr.usage = "/incr <key> [delta]";
+    registerCommand("/incr", incr,
+                    [this](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        int64_t delta = 1;
+                        if (args.size() > 1 && !args.toInt(1, delta))
+                        {
+                            reply << "Error: delta is not an integer";
+                            return;
+                        }
+
+                        int64_t value = 0;
+                        switch (_store.incr(args[0], delta, context.reactor.clock().ms(), value))
+                        {
+                            case KvStore::IncrResult::Ok: reply << value; break;
+                            case KvStore::IncrResult::NotInteger: reply << "Error: value is not an integer"; break;
+                            case KvStore::IncrResult::Overflow: reply << "Error: increment would overflow"; break;
+                        }
+                    });
+
+    CommandSpec expire;
+    expire.min_args = 2;
+    expire.max_args = 2;
+    expire.usage = "/expire <key> <seconds>";
+    registerCommand("/expire", expire,
+                    [this](CommandContext& context, const CommandArgs& args, ReplyWriter& reply)
+                    {
+                        int64_t seconds = 0;
+                        if (!args.toInt(1, seconds) || seconds < 0 || seconds > KV_MAX_TTL_SECONDS)
+                        {
+                            reply << "Error: seconds must be 0-" << KV_MAX_TTL_SECONDS;
+                            return;
+                        }
+
+                        bool found = _store.expire(args[0], static_cast<uint64_t>(seconds) * 1000,
+                                                   context.reactor.clock().ms());
+                        if (found && seconds > 0)
+                        {
+                            startKvExpiry(context.reactor);
+                        }
+                        reply << (found ? 1 : 0);
+                    });
+
+    // A stand-in for a slow command: holds a worker, never the reactor, for the given time.
+    CommandSpec sleep;
+    sleep.min_args = 1;
+    sleep.max_args = 1;
+    sleep.usage = "/sleep <milliseconds>";
+    registerOffloadedCommand("/sleep", sleep,
+                             [](const CommandArgs& args, ReplyWriter& reply)
+                             {
+                                 int64_t ms = 0;
+                                 if (!args.toInt(0, ms) || ms < 0 || ms > SLEEP_MAX_MS)
+                                 {
+                                     reply << "Error: milliseconds must be 0-" << SLEEP_MAX_MS;
+                                     return;
+                                 }
+
+                                 std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+                                 reply << "Slept " << ms << " ms";
+                             });
 }
 
-void NetworkServer::handleTcpData(int client_fd)
+void NetworkServer::startKvExpiry(Reactor& reactor)
 {
-    std::array<char, BUFFER_SIZE> buffer;
-    std::string accumulated_data;
+    if (_kv_expiry_running.exchange(true, std::memory_order_relaxed))
+        return;
 
-    while (true)
+    // Reschedules itself until no key has a TTL left; the next /expire starts it again,
+    // possibly on another reactor.
+    reactor.timers().schedule(KV_EXPIRY_INTERVAL_MS, [this, &reactor]()
     {
-        ssize_t bytes = recv(client_fd, buffer.data(), sizeof(buffer) - 1, 0);
-
-        if (bytes < 0)
+        _store.expireSample(reactor.clock().ms());
+        _kv_expiry_running.store(false, std::memory_order_relaxed);
+        if (_store.hasExpiring())
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                if (!accumulated_data.empty())
-                {
-                    processClientMessage(client_fd, accumulated_data);
-                }
-                break;
-            }
-            perror("recv");
-            removeClient(client_fd);
-            return;
-        }
-        else if (bytes == 0)
-        {
-            removeClient(client_fd);
-            return;
+            startKvExpiry(reactor);
         }
-
-        buffer[bytes] = '\0';
-        
-        if (_clients.find(client_fd) != _clients.end())
-        {
-            _clients[client_fd]->bytes_received += bytes;
-        }
-
-        accumulated_data.append(buffer.data(), bytes);
-
-        size_t pos;
-        while ((pos = accumulated_data.find('\n')) != std::string::npos)
-        {
-            std::string message = accumulated_data.substr(0, pos);
-
-            if (!message.empty() && message.back() == '\r')
-            {
-                message.pop_back();
-            }
-
-            processClientMessage(client_fd, message);
-            accumulated_data.erase(0, pos + 1);
-        }
-    }
+    });
 }
 
-void NetworkServer::handleUdpData()
+void NetworkServer::publish(const std::shared_ptr<const Publication>& publication)
 {
-    std::array<char, BUFFER_SIZE> buffer;
-    sockaddr_in client_addr{};
-    socklen_t addr_len = sizeof(client_addr);
-
-    while (true)
+    for (const auto& reactor : _reactors)
     {
-        ssize_t bytes = recvfrom(_udp_socket, buffer.data(), sizeof(buffer) - 1, 0,
-                                (sockaddr*)&client_addr, &addr_len);
-
-        if (bytes < 0)
+        if (reactor->hasSubscribers())
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                break;
-            }
-            perror("recvfrom");
-            continue;
+            reactor->deliver(publication);
         }
-
-        buffer[bytes] = '\0';
-
-        std::string client_key = std::string(inet_ntoa(client_addr.sin_addr)) + ":" + 
-                                std::to_string(ntohs(client_addr.sin_port));
-                                
-        if (_udp_clients.find(client_key) == _udp_clients.end())
-        {
-            _udp_clients.insert(client_key);
-            ++_total_connections;
-            std::cout << "[INFO] New UDP client: " << client_key << std::endl;
-        }
-
-        std::string message(buffer.data(), bytes);
-        while (!message.empty() && (message.back() == '\n' || message.back() == '\r'))
-        {
-            message.pop_back();
-        }
-
-        processClientMessage(-1, message, true, &client_addr, addr_len);
     }
 }
 
-void NetworkServer::processClientMessage(int client_fd, const std::string& message, bool is_udp,
-                                        struct sockaddr_in* udp_addr, socklen_t udp_addr_len)
+ServerStats NetworkServer::collectStats() const
 {
-    if (message.empty()) return;
-
-    std::string response;
-
-    if (message[0] == '/')
-    {
-        response = processCommand(message);
-
-        if (message == "/shutdown")
+    ServerStats stats;
+
+    for (const auto& reactor : _reactors)
+    {
+        const MetricsShard& m = reactor->metrics();
+        stats.total_connections += m.accepted.load() + m.udp_peers_seen.load();
+        stats.current_connections += m.open_connections.load();
+        stats.rejected_connections += m.rejected.load();
+        stats.udp_clients += m.udp_peers.load();
+        stats.udp_expired += m.udp_expired.load();
+        stats.udp_evicted += m.udp_evicted.load();
+        stats.total_messages += m.messages.load();
+        stats.total_commands += m.commands.load();
+        stats.bytes_received += m.bytes_in.load();
+        stats.bytes_sent += m.bytes_out.load();
+        stats.tcp_responses += m.tcp_responses.load();
+        stats.tcp_writes += m.tcp_writes.load();
+        stats.limited_tcp += m.limited_tcp.load();
+        stats.limited_udp += m.limited_udp.load();
+        stats.limited_commands += m.limited_commands.load();
+        stats.subscriptions += m.subscriptions.load();
+        stats.pubsub_delivered += m.pubsub_delivered.load();
+        stats.pubsub_dropped += m.pubsub_dropped.load();
+        stats.spin_ns += m.spin_ns.load();
+        stats.sleep_ns += m.sleep_ns.load();
+        stats.spin_hits += m.spin_hits.load();
+        stats.loop_events.add(m.loop_events);
+        stats.queue_depth.add(m.queue_depth);
+        for (const ShardHistogram& command : m.command_ns)
         {
-            sendResponse(client_fd, response, is_udp, udp_addr, udp_addr_len);
-            shutdown();
-            return;
+            stats.command_ns.add(command);
         }
     }
-    else
-    {
-        response = message;
-    }
 
-    sendResponse(client_fd, response, is_udp, udp_addr, udp_addr_len);
-}
-
-std::string NetworkServer::processCommand(const std::string& command)
-{
-    if (command == "/time")
-    {
-        return getCurrentTime();
-    }
-    else if (command == "/stats")
-    {
-        return getStats();
-    }
-    else if (command == "/shutdown")
-    {
-        return "The server is shutting down...";
-    }
-    else 
+    auto now = std::chrono::system_clock::now();
+    stats.kv = _store.stats();
+    if (_tls)
     {
-        return "Unknown command: " + command;
+        stats.tls_handshakes = _tls->handshakes();
+        stats.tls_resumed = _tls->resumed();
+        stats.tls_failed = _tls->failed();
     }
+    stats.uptime = std::chrono::duration_cast<std::chrono::seconds>(now - _start_time);
+    return stats;
 }
 
-std::string NetworkServer::getCurrentTime()
+void NetworkServer::writeStats(ReplyWriter& reply)
 {
-    auto now = std::chrono::system_clock::now();
-    auto time_t_now = std::chrono::system_clock::to_time_t(now);
-
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t_now), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+    ServerStats stats = collectStats();
+
+    char per_write[32];
+    snprintf(per_write, sizeof(per_write), "%.2f",
+             stats.tcp_writes ? static_cast<double>(stats.tcp_responses) / stats.tcp_writes : 0.0);
+
+    // Histogram quantiles are bucket upper bounds, i.e. within a factor of two.
+    reply << "Server Statistics:\n"
+          << "Total connections: " << stats.total_connections << "\n"
+          << "Current TCP connections: " << stats.current_connections << "\n"
+          << "Rejected TCP connections: " << stats.rejected_connections << "\n"
+          << "Current UDP clients: " << stats.udp_clients << "\n"
+          << "Expired UDP clients: " << stats.udp_expired << "\n"
+          << "Evicted UDP clients: " << stats.udp_evicted << "\n"
+          << "Messages: " << stats.total_messages << "\n"
+          << "Commands: " << stats.total_commands << "\n"
+          << "Bytes received: " << stats.bytes_received << "\n"
+          << "Bytes sent: " << stats.bytes_sent << "\n"
+          << "TCP responses per write: " << per_write << "\n"
+          << "Rate-limited TCP messages: " << stats.limited_tcp << "\n"
+          << "Rate-limited UDP messages: " << stats.limited_udp << "\n"
+          << "Rate-limited commands: " << stats.limited_commands << "\n"
+          << "Subscriptions: " << stats.subscriptions << "\n"
+          << "Published messages delivered: " << stats.pubsub_delivered << "\n"
+          << "Published messages dropped: " << stats.pubsub_dropped << "\n"
+          << "Store keys: " << stats.kv.keys << "\n"
+          << "Store memory bytes: " << stats.kv.memory << "\n"
+          << "Store hits/misses: " << stats.kv.hits << " / " << stats.kv.misses << "\n"
+          << "Store keys expired: " << stats.kv.expired << "\n";
+    if (_config.tls_port > 0)
+    {
+        reply << "TLS handshakes (resumed): " << stats.tls_handshakes << " (" << stats.tls_resumed << ")\n"
+              << "TLS handshakes failed: " << stats.tls_failed << "\n";
+    }
+    if (_config.low_latency)
+    {
+        reply << "Busy-poll spin/sleep (ms): " << stats.spin_ns / 1000000 << " / " << stats.sleep_ns / 1000000
+              << ", events found spinning: " << stats.spin_hits << "\n";
+    }
+    reply << "Events per wakeup p50/p99: " << stats.loop_events.quantile(0.5) << " / "
+          << stats.loop_events.quantile(0.99) << "\n"
+          << "Output queue bytes p50/p99: " << stats.queue_depth.quantile(0.5) << " / "
+          << stats.queue_depth.quantile(0.99) << "\n"
+          << "Command latency p50/p99 (ns): " << stats.command_ns.quantile(0.5) << " / "
+          << stats.command_ns.quantile(0.99) << "\n"
+          << "Reactor threads: " << _reactors.size() << "\n"
+          << "Log records dropped: " << Logger::instance().dropped() << "\n"
+          << "Log records suppressed: " << Logger::instance().suppressed() << "\n"
+          << "Uptime: " << stats.uptime.count() << " seconds";
 }
 
-std::string NetworkServer::getStats()
+void NetworkServer::writeMetrics(std::string& out) const
 {
-    auto now = std::chrono::system_clock::now();
-    auto uptime = std::chrono::duration_cast<std::chrono::seconds>(now - _start_time);
-
-    std::stringstream ss;
-    ss << "Server Statistics:\n";
-    ss << "Total connections: " << _total_connections.load() << "\n";
-    ss << "Current TCP connections: " << _current_connections.load() << "\n";
-    ss << "Current UDP clients: " << _udp_clients.size() << "\n";
-    ss << "Uptime: " << uptime.count() << " seconds";
-    
-    return ss.str();
-}
-
-void NetworkServer::sendResponse(int client_fd, const std::string& response, bool is_udp,
-                                sockaddr_in* udp_addr, socklen_t udp_addr_len)
-{
-    if (is_udp && udp_addr)
-    {
-        std::string data = response + "\n";
-        ssize_t sent = sendto(_udp_socket, data.c_str(), data.length(), 0,
-                            (sockaddr*)udp_addr, udp_addr_len);
-        if (sent < 0)
+    PrometheusWriter prom(out);
+    ServerStats stats = collectStats();
+
+    struct PerReactor
+    {
+        const char* name;
+        const char* type;
+        const char* help;
+        const ShardCounter MetricsShard::* counter;
+    };
+    static const PerReactor per_reactor[] = {
+        { "netserver_connections_accepted_total", "counter", "TCP connections accepted.", &MetricsShard::accepted },
+        { "netserver_connections_closed_total", "counter", "TCP connections closed.", &MetricsShard::closed },
+        { "netserver_connections_rejected_total", "counter", "TCP connections reset at the connection limit.", &MetricsShard::rejected },
+        { "netserver_connections_open", "gauge", "TCP connections open.", &MetricsShard::open_connections },
+        { "netserver_udp_peers", "gauge", "UDP peers tracked.", &MetricsShard::udp_peers },
+        { "netserver_udp_peers_seen_total", "counter", "UDP peers ever tracked.", &MetricsShard::udp_peers_seen },
+        { "netserver_udp_peers_expired_total", "counter", "UDP peers expired after being idle.", &MetricsShard::udp_expired },
+        { "netserver_udp_peers_evicted_total", "counter", "UDP peers evicted from a full table.", &MetricsShard::udp_evicted },
+        { "netserver_messages_total", "counter", "Lines and datagrams handled.", &MetricsShard::messages },
+        { "netserver_commands_total", "counter", "Slash commands handled.", &MetricsShard::commands },
+        { "netserver_commands_offloaded_total", "counter", "Commands run on the worker pool.", &MetricsShard::offloaded },
+        { "netserver_received_bytes_total", "counter", "TCP and UDP payload bytes received.", &MetricsShard::bytes_in },
+        { "netserver_sent_bytes_total", "counter", "TCP and UDP payload bytes sent.", &MetricsShard::bytes_out },
+        { "netserver_tcp_responses_total", "counter", "Replies queued on TCP connections.", &MetricsShard::tcp_responses },
+        { "netserver_tcp_writes_total", "counter", "TCP send calls.", &MetricsShard::tcp_writes },
+        { "netserver_rate_limited_tcp_total", "counter", "TCP messages held back by a connection's rate limit.", &MetricsShard::limited_tcp },
+        { "netserver_rate_limited_udp_total", "counter", "UDP messages dropped or rejected by a peer's rate limit.", &MetricsShard::limited_udp },
+        { "netserver_rate_limited_commands_total", "counter", "Commands held back by the command's rate limit.", &MetricsShard::limited_commands },
+        { "netserver_subscriptions", "gauge", "Pub/sub subscriptions of TCP clients and UDP peers.", &MetricsShard::subscriptions },
+        { "netserver_published_delivered_total", "counter", "Published messages queued to subscribers.", &MetricsShard::pubsub_delivered },
+        { "netserver_published_dropped_total", "counter", "Published messages not sent to slow subscribers.", &MetricsShard::pubsub_dropped },
+    };
+
+    for (const PerReactor& metric : per_reactor)
+    {
+        prom.header(metric.name, metric.type, metric.help);
+        for (const auto& reactor : _reactors)
         {
-            perror("sendto");
+            std::string labels = "reactor=\"" + std::to_string(reactor->id()) + "\"";
+            prom.sample(metric.name, labels, (reactor->metrics().*metric.counter).load());
         }
     }
-    else if (client_fd >= 0)
-    {
-        std::string data = response + "\n";
-        ssize_t total_sent = 0;
 
-        while (total_sent < static_cast<ssize_t>(data.length()))
+    if (_config.low_latency)
+    {
+        prom.header("netserver_busy_poll_hits_total", "counter", "Busy polls that found events before blocking.");
+        for (const auto& reactor : _reactors)
         {
-            ssize_t sent = send(client_fd, data.c_str() + total_sent, 
-                                data.length() - total_sent, MSG_NOSIGNAL);
-
-            if (sent < 0)
-            {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) 
-                {
-                    break;
-                }
-                perror("send");
-                break;
-            }
-
-            total_sent += sent;
+            std::string labels = "reactor=\"" + std::to_string(reactor->id()) + "\"";
+            prom.sample("netserver_busy_poll_hits_total", labels, reactor->metrics().spin_hits.load());
+        }
 
-            if (_clients.find(client_fd) != _clients.end())
+        struct PerReactorTime
+        {
+            const char* name;
+            const char* help;
+            const ShardCounter MetricsShard::* counter;
+        };
+        static const PerReactorTime per_reactor_time[] = {
+            { "netserver_busy_poll_seconds_total", "Time spent polling for events without sleeping.", &MetricsShard::spin_ns },
+            { "netserver_sleep_seconds_total", "Time spent blocked waiting for events.", &MetricsShard::sleep_ns },
+        };
+
+        for (const PerReactorTime& metric : per_reactor_time)
+        {
+            prom.header(metric.name, "counter", metric.help);
+            for (const auto& reactor : _reactors)
             {
-                _clients[client_fd]->bytes_sent += sent;
+                std::string labels = "reactor=\"" + std::to_string(reactor->id()) + "\"";
+                prom.sample(metric.name, labels, static_cast<double>((reactor->metrics().*metric.counter).load()) * 1e-9);
             }
         }
     }
-}
 
-void NetworkServer::removeClient(int client_fd)
-{
-    auto it = _clients.find(client_fd);
-    if (it != _clients.end())
-    {
-        std::cout << "[INFO] Client disconnected: " << it->second->address 
-                  << ":" << it->second->port << " (fd: " << client_fd << ")" << std::endl;
-        _clients.erase(it);
-        --_current_connections;
-    }
+    prom.header("netserver_loop_events", "histogram", "I/O events handled per event loop wakeup.");
+    prom.histogram("netserver_loop_events", "", stats.loop_events, 1.0);
 
-    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
-    close(client_fd);
+    prom.header("netserver_output_queue_bytes", "histogram", "Bytes queued on a connection when its replies are flushed.");
+    prom.histogram("netserver_output_queue_bytes", "", stats.queue_depth, 1.0);
+
+    prom.header("netserver_command_duration_seconds", "histogram", "Time to run a command and queue its reply.");
+    size_t timed = std::min(_commands.size(), MetricsShard::MAX_TIMED_COMMANDS);
+    for (size_t i = 0; i < timed; ++i)
+    {
+        HistogramSnapshot latency;
+        for (const auto& reactor : _reactors)
+        {
+            latency.add(reactor->metrics().command_ns[i]);
+        }
+        std::string labels = "command=\"" + std::string(_commands.name(i)) + "\"";
+        prom.histogram("netserver_command_duration_seconds", labels, latency, 1e-9);
+    }
+
+    prom.header("netserver_store_keys", "gauge", "Keys in the key-value store.");
+    prom.sample("netserver_store_keys", "", stats.kv.keys);
+    prom.header("netserver_store_memory_bytes", "gauge", "Bytes held by the key-value store's tables and arenas.");
+    prom.sample("netserver_store_memory_bytes", "", stats.kv.memory);
+    prom.header("netserver_store_hits_total", "counter", "Store reads that found their key.");
+    prom.sample("netserver_store_hits_total", "", stats.kv.hits);
+    prom.header("netserver_store_misses_total", "counter", "Store reads of missing keys.");
+    prom.sample("netserver_store_misses_total", "", stats.kv.misses);
+    prom.header("netserver_store_expired_total", "counter", "Store keys removed when their TTL ran out.");
+    prom.sample("netserver_store_expired_total", "", stats.kv.expired);
+
+    if (_config.tls_port > 0)
+    {
+        prom.header("netserver_tls_handshakes_total", "counter", "TLS handshakes completed and handed to kernel TLS.");
+        prom.sample("netserver_tls_handshakes_total", "", stats.tls_handshakes);
+        prom.header("netserver_tls_resumed_total", "counter", "TLS handshakes that resumed an earlier session.");
+        prom.sample("netserver_tls_resumed_total", "", stats.tls_resumed);
+        prom.header("netserver_tls_handshake_failures_total", "counter", "TLS handshakes that failed, timed out or could not use kernel TLS.");
+        prom.sample("netserver_tls_handshake_failures_total", "", stats.tls_failed);
+    }
+
+    prom.header("netserver_log_records_dropped_total", "counter", "Log records lost to full log rings.");
+    prom.sample("netserver_log_records_dropped_total", "", Logger::instance().dropped());
+    prom.header("netserver_log_records_suppressed_total", "counter", "Log records held back by the rate limit.");
+    prom.sample("netserver_log_records_suppressed_total", "", Logger::instance().suppressed());
+
+    prom.header("netserver_uptime_seconds", "gauge", "Seconds since the server started.");
+    prom.sample("netserver_uptime_seconds", "", static_cast<uint64_t>(stats.uptime.count()));
 }
 
 void NetworkServer::shutdown()
 {
+    // Reactors look at the flag as soon as their eventfd wakes them, then drain and close
+    // their own sockets. The TLS acceptor stops handing them new ones first.
     _running = false;
-
-    for (auto& [fd, client] : _clients)
+    if (_tls)
     {
-        close(fd);
+        _tls->stop();
     }
-
-    if (_tcp_socket >= 0)
+    for (auto& reactor : _reactors)
     {
-        close(_tcp_socket);
-        _tcp_socket = -1;
+        reactor->wake();
     }
 
-    if (_udp_socket >= 0)
+    if (_metrics_http)
     {
-        close(_udp_socket);
-        _udp_socket = -1;
+        _metrics_http->stop();
     }
-
-    if (_epoll_fd >= 0)
-    {
-        close(_epoll_fd);
-        _epoll_fd = -1;
-    }
-}
\ No newline at end of file
+}
@@ -0,0 +1,244 @@
+#include "../include/timer_wheel.hpp"
+#include <algorithm>
+#include <climits>
+
+TimerWheel::TimerWheel(uint64_t now_ms)
+    :   _current{ now_ms }, _now{ now_ms }
+{
+    for (auto& level : _heads)
+    {
+        level.fill(NIL);
+    }
+}
+
+TimerId TimerWheel::schedule(uint64_t delay_ms, Callback callback)
+{
+    return add(delay_ms, 0, std::move(callback));
+}
+
+TimerId TimerWheel::schedulePeriodic(uint64_t interval_ms, Callback callback)
+{
+    return add(interval_ms, std::max<uint64_t>(interval_ms, 1), std::move(callback));
+}
+
+TimerId TimerWheel::add(uint64_t delay_ms, uint64_t interval_ms, Callback callback)
+{
+    uint32_t index;
+    if (!_free.empty())
+    {
+        index = _free.back();
+        _free.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(_nodes.size());
+        _nodes.emplace_back();
+    }
+
+    Node& node = _nodes[index];
+    node.expires = _now + delay_ms;
+    node.interval = interval_ms;
+    node.callback = std::move(callback);
+    link(index);
+    ++_active;
+
+    return (static_cast<uint64_t>(node.generation) << 32) | index;
+}
+
+void TimerWheel::cancel(TimerId id)
+{
+    uint32_t index = static_cast<uint32_t>(id);
+    if (index >= _nodes.size() || _nodes[index].generation != static_cast<uint32_t>(id >> 32))
+        return;
+
+    if (_nodes[index].linked)
+    {
+        unlink(index);
+    }
+    release(index);
+}
+
+void TimerWheel::release(uint32_t index)
+{
+    Node& node = _nodes[index];
+    node.callback = nullptr;
+    if (++node.generation == 0)
+        node.generation = 1;
+    _free.push_back(index);
+    --_active;
+}
+
+void TimerWheel::link(uint32_t index)
+{
+    Node& node = _nodes[index];
+
+    // Nothing may land on the tick being fired right now, or it would never run.
+    uint64_t earliest = _firing ? _current + 1 : _current;
+    uint64_t expires = std::max(node.expires, earliest);
+    uint64_t delta = expires - _current;
+    if (delta > MAX_DELAY)
+    {
+        // Park it at the far end; cascading brings it back until it is in range.
+        delta = MAX_DELAY;
+        expires = _current + MAX_DELAY;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t{ 1 } << (SLOT_BITS * (level + 1))))
+    {
+        ++level;
+    }
+
+    uint8_t slot = static_cast<uint8_t>((expires >> (SLOT_BITS * level)) & SLOT_MASK);
+    uint32_t& head = _heads[level][slot];
+
+    node.level = static_cast<uint8_t>(level);
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = head;
+    if (head != NIL)
+    {
+        _nodes[head].prev = index;
+    }
+    head = index;
+    node.linked = true;
+    _occupied[level] |= uint64_t{ 1 } << slot;
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    Node& node = _nodes[index];
+
+    if (node.prev != NIL)
+    {
+        _nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        _heads[node.level][node.slot] = node.next;
+        if (node.next == NIL)
+        {
+            _occupied[node.level] &= ~(uint64_t{ 1 } << node.slot);
+        }
+    }
+
+    if (node.next != NIL)
+    {
+        _nodes[node.next].prev = node.prev;
+    }
+
+    node.prev = node.next = NIL;
+    node.linked = false;
+}
+
+void TimerWheel::cascade(int level)
+{
+    uint8_t slot = static_cast<uint8_t>((_current >> (SLOT_BITS * level)) & SLOT_MASK);
+
+    uint32_t index = _heads[level][slot];
+    _heads[level][slot] = NIL;
+    _occupied[level] &= ~(uint64_t{ 1 } << slot);
+
+    while (index != NIL)
+    {
+        uint32_t next = _nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::runSlot(uint8_t slot)
+{
+    uint32_t index;
+    while ((index = _heads[0][slot]) != NIL)
+    {
+        unlink(index);
+
+        // The callback may schedule timers and grow _nodes, so it runs from a local copy.
+        uint32_t generation = _nodes[index].generation;
+        Callback callback = std::move(_nodes[index].callback);
+        _firing = true;
+        callback();
+        _firing = false;
+
+        Node& node = _nodes[index];
+        if (node.generation != generation)
+            continue;   // cancelled from inside its own callback
+
+        if (node.interval != 0)
+        {
+            node.expires = _current + node.interval;
+            node.callback = std::move(callback);
+            link(index);
+        }
+        else
+        {
+            release(index);
+        }
+    }
+}
+
+void TimerWheel::advance(uint64_t now_ms)
+{
+    _now = std::max(_now, now_ms);
+
+    while (_current <= now_ms)
+    {
+        if (_active == 0)
+        {
+            _current = now_ms + 1;
+            break;
+        }
+
+        uint8_t slot = static_cast<uint8_t>(_current & SLOT_MASK);
+        if (slot == 0)
+        {
+            for (int level = 1; level < LEVELS; ++level)
+            {
+                cascade(level);
+                if (((_current >> (SLOT_BITS * level)) & SLOT_MASK) != 0)
+                    break;
+            }
+        }
+        else if (_occupied[0] == 0)
+        {
+            // Nothing due before the next level-0 wrap: jump straight to it.
+            _current = std::min((_current | SLOT_MASK) + 1, now_ms + 1);
+            continue;
+        }
+
+        runSlot(slot);
+        ++_current;
+    }
+}
+
+int TimerWheel::timeoutMs(uint64_t now_ms) const
+{
+    if (_active == 0)
+        return -1;
+
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        int shift = SLOT_BITS * level;
+        uint64_t bits = _occupied[level];
+        while (bits)
+        {
+            uint64_t slot = static_cast<uint64_t>(__builtin_ctzll(bits));
+            bits &= bits - 1;
+
+            // Tick at which this slot is next fired (level 0) or cascaded (upper levels).
+            uint64_t tick = (((_current >> shift) & ~SLOT_MASK) | slot) << shift;
+            if (tick < _current)
+            {
+                tick += uint64_t{ SLOTS } << shift;
+            }
+            next = std::min(next, tick);
+        }
+    }
+
+    if (next <= now_ms)
+        return 0;
+
+    return static_cast<int>(std::min<uint64_t>(next - now_ms, INT_MAX));
+}
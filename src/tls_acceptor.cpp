@@ -0,0 +1,398 @@
+#include "../include/tls_acceptor.hpp"
+
+#ifdef WITH_TLS
+
+#include "../include/reactor.hpp"
+#include "../include/endpoint.hpp"
+#include "../include/loop_clock.hpp"
+#include "../include/logger.hpp"
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+
+// Ciphers every kTLS kernel can take over; a session with anything else could not be
+// handed to a reactor.
+const char* const TLS12_CIPHERS = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                                  "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+const char* const TLS13_CIPHERS = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384";
+
+const unsigned char SESSION_CONTEXT[] = "cpp-network-server";
+
+std::string sslError()
+{
+    char text[256];
+    ERR_error_string_n(ERR_get_error(), text, sizeof(text));
+    ERR_clear_error();
+    return text;
+}
+
+} // namespace
+
+TlsAcceptor::TlsAcceptor(const ServerConfig& config, const std::vector<std::unique_ptr<Reactor>>& reactors)
+    :   _config{ config },
+        _reactors{ reactors },
+        _timers{ monotonicMs() }
+{
+}
+
+TlsAcceptor::~TlsAcceptor()
+{
+    stop();
+    join();
+
+    for (auto& [fd, handshake] : _pending)
+    {
+        SSL_free(handshake.ssl);
+        close(fd);
+    }
+    if (_listener >= 0)
+    {
+        close(_listener);
+    }
+    if (_epoll_fd >= 0)
+    {
+        close(_epoll_fd);
+    }
+    if (_stop_fd >= 0)
+    {
+        close(_stop_fd);
+    }
+    SSL_CTX_free(_context);
+}
+
+bool TlsAcceptor::kernelTlsAvailable()
+{
+    // The "tls" ULP attaches only to a connected socket, so try it on a loopback pair.
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool available = false;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+
+    if (listener >= 0 && client >= 0
+        && bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0
+        && ::listen(listener, 1) == 0
+        && getsockname(listener, (sockaddr*)&addr, &addr_len) == 0
+        && connect(client, (sockaddr*)&addr, sizeof(addr)) == 0)
+    {
+        available = setsockopt(client, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+    }
+
+    if (client >= 0)
+    {
+        close(client);
+    }
+    if (listener >= 0)
+    {
+        close(listener);
+    }
+    return available;
+}
+
+bool TlsAcceptor::createContext()
+{
+    _context = SSL_CTX_new(TLS_server_method());
+    if (!_context)
+    {
+        std::cerr << "[ERROR] SSL_CTX_new: " << sslError() << std::endl;
+        return false;
+    }
+
+    // OpenSSL installs the keys with TLS_TX/TLS_RX itself once the handshake is done.
+    // Before 3.2 it can only do that in both directions for TLS 1.2.
+    SSL_CTX_set_options(_context, SSL_OP_ENABLE_KTLS | SSL_OP_CIPHER_SERVER_PREFERENCE);
+    SSL_CTX_set_min_proto_version(_context, TLS1_2_VERSION);
+#if OPENSSL_VERSION_NUMBER < 0x30200000L
+    SSL_CTX_set_max_proto_version(_context, TLS1_2_VERSION);
+#endif
+    SSL_CTX_set_cipher_list(_context, TLS12_CIPHERS);
+    SSL_CTX_set_ciphersuites(_context, TLS13_CIPHERS);
+
+    // Resumption skips the key exchange: a session id from the server cache or a ticket.
+    SSL_CTX_set_session_cache_mode(_context, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(_context, SESSION_CONTEXT, sizeof(SESSION_CONTEXT) - 1);
+    SSL_CTX_sess_set_cache_size(_context, SESSION_CACHE_SIZE);
+
+    if (SSL_CTX_use_certificate_chain_file(_context, _config.tls_cert.c_str()) != 1)
+    {
+        std::cerr << "[ERROR] --tls-cert " << _config.tls_cert << ": " << sslError() << std::endl;
+        return false;
+    }
+    if (SSL_CTX_use_PrivateKey_file(_context, _config.tls_key.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(_context) != 1)
+    {
+        std::cerr << "[ERROR] --tls-key " << _config.tls_key << ": " << sslError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TlsAcceptor::listen()
+{
+    if (!kernelTlsAvailable())
+    {
+        std::cerr << "[ERROR] --tls-port needs kernel TLS, which is unavailable (modprobe tls)" << std::endl;
+        return false;
+    }
+    if (!createContext())
+        return false;
+
+    _stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_stop_fd < 0 || _epoll_fd < 0)
+    {
+        perror("eventfd/epoll TLS");
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = _stop_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _stop_fd, &event);
+
+    Endpoint endpoint = anyEndpoint(_config.tls_port);
+    int sock = _listener = openSocket(endpoint, SOCK_STREAM);
+    if (sock < 0)
+        return false;
+
+    int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 || !setNonBlocking(sock))
+    {
+        perror("setsockopt TLS");
+        return false;
+    }
+    if (bind(sock, (sockaddr*)&endpoint.addr, endpoint.addr_len) < 0)
+    {
+        perror("bind TLS");
+        return false;
+    }
+    if (::listen(sock, SOMAXCONN) < 0)
+    {
+        perror("listen TLS");
+        return false;
+    }
+
+    event.data.fd = sock;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, sock, &event);
+    return true;
+}
+
+void TlsAcceptor::start()
+{
+    _thread = std::thread([this]() { run(); });
+}
+
+void TlsAcceptor::stop()
+{
+    uint64_t one = 1;
+    if (_stop_fd >= 0 && write(_stop_fd, &one, sizeof(one)) < 0)
+    {
+        LOG_ERROR("eventfd write: %s", strerror(errno));
+    }
+}
+
+void TlsAcceptor::join()
+{
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void TlsAcceptor::run()
+{
+    epoll_event events[MAX_EVENTS];
+    while (true)
+    {
+        int ready = epoll_wait(_epoll_fd, events, MAX_EVENTS, _timers.timeoutMs(monotonicMs()));
+        if (ready < 0 && errno != EINTR)
+        {
+            LOG_ERROR("epoll_wait TLS: %s", strerror(errno));
+            return;
+        }
+
+        for (int i = 0; i < ready; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == _stop_fd)
+                return;
+
+            if (fd == _listener)
+            {
+                acceptAll();
+            }
+            else
+            {
+                advance(fd);
+            }
+        }
+        _timers.advance(monotonicMs());
+    }
+}
+
+void TlsAcceptor::acceptAll()
+{
+    while (true)
+    {
+        sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(_listener, (sockaddr*)&addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("accept TLS: %s", strerror(errno));
+            }
+            return;
+        }
+
+        SSL* ssl = SSL_new(_context);
+        if (!ssl || SSL_set_fd(ssl, fd) != 1)
+        {
+            LOG_ERROR("SSL_new: %s", sslError().c_str());
+            SSL_free(ssl);
+            close(fd);
+            continue;
+        }
+        SSL_set_accept_state(ssl);
+
+        Handshake& handshake = _pending[fd];
+        handshake.ssl = ssl;
+        handshake.addr = addr;
+        handshake.addr_len = addr_len;
+        handshake.timeout = _timers.schedule(HANDSHAKE_TIMEOUT_MS, [this, fd]()
+        {
+            Handshake& expired = _pending[fd];
+            expired.timeout = 0;
+            LOG_INFO("TLS handshake with %s timed out", formatAddress(expired.addr).c_str());
+            drop(fd);
+        });
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+        // The ClientHello is often there already.
+        advance(fd);
+    }
+}
+
+void TlsAcceptor::advance(int fd)
+{
+    auto it = _pending.find(fd);
+    if (it == _pending.end())
+        return;
+    Handshake& handshake = it->second;
+
+    int result = SSL_do_handshake(handshake.ssl);
+    if (result == 1)
+    {
+        finish(fd, handshake);
+        return;
+    }
+
+    epoll_event event{};
+    event.data.fd = fd;
+    switch (SSL_get_error(handshake.ssl, result))
+    {
+        case SSL_ERROR_WANT_READ:
+            event.events = EPOLLIN;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+            return;
+        case SSL_ERROR_WANT_WRITE:
+            event.events = EPOLLOUT;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+            return;
+        default:
+            LOG_INFO("TLS handshake with %s failed: %s", formatAddress(handshake.addr).c_str(), sslError().c_str());
+            drop(fd);
+            return;
+    }
+}
+
+void TlsAcceptor::finish(int fd, Handshake& handshake)
+{
+    SSL* ssl = handshake.ssl;
+    if (!BIO_get_ktls_send(SSL_get_wbio(ssl)) || !BIO_get_ktls_recv(SSL_get_rbio(ssl)))
+    {
+        LOG_WARN("Kernel TLS refused the session with %s (%s, %s), closing",
+                 formatAddress(handshake.addr).c_str(), SSL_get_version(ssl), SSL_get_cipher_name(ssl));
+        drop(fd);
+        return;
+    }
+
+    _handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (SSL_session_reused(ssl))
+    {
+        _resumed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The socket BIO does not own the fd, and freeing the session sends nothing: the
+    // kernel keeps the keys and the record sequence numbers.
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    _timers.cancel(handshake.timeout);
+    sockaddr_storage addr = handshake.addr;
+    socklen_t addr_len = handshake.addr_len;
+    SSL_free(ssl);
+    _pending.erase(fd);
+
+    Reactor& reactor = *_reactors[_next_reactor];
+    _next_reactor = (_next_reactor + 1) % _reactors.size();
+    reactor.adoptClient(fd, addr, addr_len);
+}
+
+void TlsAcceptor::drop(int fd)
+{
+    auto it = _pending.find(fd);
+    if (it == _pending.end())
+        return;
+
+    _failed.fetch_add(1, std::memory_order_relaxed);
+    _timers.cancel(it->second.timeout);
+    SSL_free(it->second.ssl);
+    _pending.erase(it);
+    close(fd);
+}
+
+#else // WITH_TLS
+
+#include <iostream>
+
+// Built without OpenSSL: --tls-port is refused at startup.
+
+TlsAcceptor::TlsAcceptor(const ServerConfig& config, const std::vector<std::unique_ptr<Reactor>>& reactors)
+    :   _config{ config },
+        _reactors{ reactors },
+        _timers{ 0 }
+{
+}
+
+TlsAcceptor::~TlsAcceptor() = default;
+
+bool TlsAcceptor::listen()
+{
+    std::cerr << "[ERROR] --tls-port: built without TLS support (make clean && make TLS=1)" << std::endl;
+    return false;
+}
+
+void TlsAcceptor::start() {}
+void TlsAcceptor::stop() {}
+void TlsAcceptor::join() {}
+
+#endif // WITH_TLS
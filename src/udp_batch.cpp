@@ -0,0 +1,264 @@
+#include "../include/udp_batch.hpp"
+#include "../include/logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <netinet/udp.h>
+
+UdpBatch::UdpBatch(size_t batch_size)
+    :   _batch_size{ batch_size },
+        _recv_storage(batch_size * DATAGRAM_SIZE),
+        _peers(batch_size),
+        _recv_iov(batch_size),
+        _recv_msgs(batch_size)
+{
+    for (size_t i = 0; i < _batch_size; ++i)
+    {
+        _recv_iov[i].iov_base = _recv_storage.data() + i * DATAGRAM_SIZE;
+        _recv_iov[i].iov_len = DATAGRAM_SIZE;
+
+        msghdr& hdr = _recv_msgs[i].msg_hdr;
+        hdr.msg_name = &_peers[i];
+        hdr.msg_iov = &_recv_iov[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    _replies.reserve(_batch_size);
+}
+
+void UdpBatch::probe(int fd)
+{
+    int segment = 0;
+    socklen_t len = sizeof(segment);
+    _gso_enabled = getsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+}
+
+int UdpBatch::receive(int fd)
+{
+    if (!_mmsg_supported)
+        return receiveEach(fd);
+
+    for (size_t i = 0; i < _batch_size; ++i)
+    {
+        _recv_msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+
+    int count;
+    do
+    {
+        count = recvmmsg(fd, _recv_msgs.data(), _batch_size, MSG_DONTWAIT, nullptr);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        if (errno == ENOSYS)
+        {
+            _mmsg_supported = false;
+            return receiveEach(fd);
+        }
+        LOG_ERROR("recvmmsg: %s", strerror(errno));
+        return -1;
+    }
+
+    return count;
+}
+
+int UdpBatch::receiveEach(int fd)
+{
+    size_t count = 0;
+    while (count < _batch_size)
+    {
+        socklen_t addr_len = sizeof(sockaddr_storage);
+        ssize_t bytes = recvfrom(fd, _recv_iov[count].iov_base, DATAGRAM_SIZE, 0,
+                                 (sockaddr*)&_peers[count], &addr_len);
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            LOG_ERROR("recvfrom: %s", strerror(errno));
+            return count > 0 ? static_cast<int>(count) : -1;
+        }
+
+        _recv_msgs[count].msg_len = static_cast<unsigned>(bytes);
+        _recv_msgs[count].msg_hdr.msg_namelen = addr_len;
+        ++count;
+    }
+
+    return static_cast<int>(count);
+}
+
+std::string_view UdpBatch::payload(int i) const
+{
+    return std::string_view(static_cast<const char*>(_recv_iov[i].iov_base), _recv_msgs[i].msg_len);
+}
+
+void UdpBatch::queueReply(const sockaddr_storage& addr, socklen_t addr_len, std::string_view data)
+{
+    size_t offset = _out.size();
+    _out.append(data);
+    commitReply(addr, addr_len, offset);
+}
+
+void UdpBatch::commitReply(const sockaddr_storage& addr, socklen_t addr_len, size_t offset, bool newline)
+{
+    if (newline)
+    {
+        _out.push_back('\n');
+    }
+    _replies.push_back(Reply{ addr, addr_len, offset, _out.size() - offset });
+}
+
+void UdpBatch::queueRepeat(const sockaddr_storage& addr, socklen_t addr_len, size_t offset, size_t size)
+{
+    _replies.push_back(Reply{ addr, addr_len, offset, size });
+}
+
+bool UdpBatch::sameDestination(const Reply& a, const Reply& b) const
+{
+    return a.addr_len == b.addr_len && std::memcmp(&a.addr, &b.addr, a.addr_len) == 0;
+}
+
+void UdpBatch::buildMessages(size_t first_reply)
+{
+    _send_iov.clear();
+    _send_msgs.clear();
+    _send_control.clear();
+    _send_first.clear();
+
+    // Reserve up front: the message headers point into these vectors.
+    size_t remaining = _replies.size() - first_reply;
+    _send_iov.reserve(remaining);
+    _send_msgs.reserve(remaining);
+    _send_control.reserve(remaining);
+
+    for (size_t i = first_reply; i < _replies.size();)
+    {
+        const Reply& head = _replies[i];
+        size_t segment = head.size;
+        size_t total = head.size;
+        size_t j = i + 1;
+
+        // Same-peer replies ride in one GSO send: every segment but the last must be
+        // exactly `segment` bytes, and they must follow each other in _out (repeats need not).
+        if (_gso_enabled)
+        {
+            while (j < _replies.size() && j - i < MAX_GSO_SEGMENTS &&
+                   sameDestination(_replies[j], head) && _replies[j].size <= segment &&
+                   _replies[j].offset == _replies[j - 1].offset + _replies[j - 1].size &&
+                   total + _replies[j].size <= MAX_GSO_BYTES)
+            {
+                total += _replies[j].size;
+                ++j;
+                if (_replies[j - 1].size < segment)
+                    break;
+            }
+        }
+
+        _send_iov.push_back(iovec{ _out.data() + head.offset, total });
+
+        mmsghdr msg{};
+        msg.msg_hdr.msg_name = const_cast<sockaddr_storage*>(&head.addr);
+        msg.msg_hdr.msg_namelen = head.addr_len;
+        msg.msg_hdr.msg_iov = &_send_iov.back();
+        msg.msg_hdr.msg_iovlen = 1;
+
+        if (j - i > 1)
+        {
+            _send_control.emplace_back();
+            SegmentControl& control = _send_control.back();
+            std::memset(&control, 0, sizeof(control));
+
+            msg.msg_hdr.msg_control = control.buf;
+            msg.msg_hdr.msg_controllen = sizeof(control.buf);
+
+            cmsghdr* cm = CMSG_FIRSTHDR(&msg.msg_hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso_size = static_cast<uint16_t>(segment);
+            std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        }
+
+        _send_msgs.push_back(msg);
+        _send_first.push_back(i);
+        i = j;
+    }
+}
+
+void UdpBatch::flush(int fd)
+{
+    if (_replies.empty())
+        return;
+
+    if (!_mmsg_supported)
+    {
+        sendEach(fd, 0);
+        _replies.clear();
+        _out.clear();
+        return;
+    }
+
+    size_t first_reply = 0;
+    bool rebuild = true;
+    while (rebuild)
+    {
+        rebuild = false;
+        buildMessages(first_reply);
+
+        size_t next = 0;
+        while (next < _send_msgs.size())
+        {
+            int sent = sendmmsg(fd, &_send_msgs[next], _send_msgs.size() - next, 0);
+            if (sent >= 0)
+            {
+                next += sent;
+                continue;
+            }
+
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;  // socket buffer full: the rest of the batch is dropped, as UDP would
+
+            if (errno == ENOSYS)
+            {
+                _mmsg_supported = false;
+                sendEach(fd, _send_first[next]);
+                break;
+            }
+
+            if (_send_msgs[next].msg_hdr.msg_controllen != 0)
+            {
+                // The kernel or device refused segmentation offload; resend without it.
+                _gso_enabled = false;
+                first_reply = _send_first[next];
+                rebuild = true;
+                break;
+            }
+
+            LOG_ERROR("sendmmsg: %s", strerror(errno));
+            ++next;
+        }
+    }
+
+    _replies.clear();
+    _out.clear();
+}
+
+void UdpBatch::sendEach(int fd, size_t first_reply)
+{
+    for (size_t i = first_reply; i < _replies.size(); ++i)
+    {
+        const Reply& reply = _replies[i];
+        ssize_t sent = sendto(fd, _out.data() + reply.offset, reply.size, 0,
+                              (const sockaddr*)&reply.addr, reply.addr_len);
+        if (sent < 0)
+        {
+            LOG_ERROR("sendto: %s", strerror(errno));
+        }
+    }
+}
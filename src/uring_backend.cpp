@@ -0,0 +1,730 @@
+#include "../include/uring_backend.hpp"
+#include "../include/reactor.hpp"
+#include "../include/logger.hpp"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+static int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                        const void* arg, size_t arg_size)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+UringBackend::UringBackend(Reactor& reactor)
+    :   _reactor{ reactor }
+{
+}
+
+UringBackend::~UringBackend()
+{
+    if (_ring_fd >= 0)
+    {
+        close(_ring_fd);
+    }
+    if (_sqes)
+    {
+        munmap(_sqes, _sqes_size);
+    }
+    if (_cq_ring && _cq_ring != _sq_ring)
+    {
+        munmap(_cq_ring, _cq_ring_size);
+    }
+    if (_sq_ring)
+    {
+        munmap(_sq_ring, _sq_ring_size);
+    }
+    if (_buf_ring)
+    {
+        munmap(_buf_ring, _buf_ring_size);
+    }
+    delete[] _buffers;
+}
+
+bool UringBackend::setup()
+{
+    // No version checks: what the kernel cannot do fails here with EINVAL, and the
+    // reactor runs on epoll instead. These setup flags, multishot accept and buffer rings
+    // all arrived in Linux 5.19; multishot recv, from 6.0, is found out on first use.
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = RING_ENTRIES * 4;
+
+    _ring_fd = ioUringSetup(RING_ENTRIES, &params);
+    if (_ring_fd < 0)
+        return false;
+
+    // Timed waits and lossless completion queues are assumed throughout.
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+        return false;
+
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    _ring_fd, IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED)
+    {
+        _sq_ring = nullptr;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        _cq_ring = _sq_ring;
+    }
+    else
+    {
+        _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _ring_fd, IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED)
+        {
+            _cq_ring = nullptr;
+            return false;
+        }
+    }
+
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      _ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(_sq_ring);
+    _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _sq_local_tail = *_sq_tail;
+
+    // SQE slots are used in ring order, so the indirection array is the identity.
+    unsigned* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < _sq_entries; ++i)
+    {
+        sq_array[i] = i;
+    }
+
+    char* cq = static_cast<char*>(_cq_ring);
+    _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    _buf_ring_size = BUFFER_COUNT * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+    _buf_ring = static_cast<io_uring_buf_ring*>(ring);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+    reg.ring_entries = BUFFER_COUNT;
+    reg.bgid = BUFFER_GROUP;
+    if (ioUringRegister(_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return false;
+
+    _buffers = new char[BUFFER_COUNT * BUFFER_SIZE];
+    for (unsigned i = 0; i < BUFFER_COUNT; ++i)
+    {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+
+    return true;
+}
+
+bool UringBackend::start(const std::vector<int>& tcp_sockets, const std::vector<int>& udp_sockets,
+                         int wake_fd, int signal_fd)
+{
+    _wake_fd = wake_fd;
+    _signal_fd = signal_fd;
+
+    size_t batch = static_cast<size_t>(_reactor.config().accept_budget);
+    _accepts.resize(tcp_sockets.size() * batch);
+
+    for (int fd : tcp_sockets)
+    {
+        // io_uring waits for readiness itself; on an O_NONBLOCK listener the kernel would
+        // complete the accept with -EAGAIN instead.
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) < 0)
+        {
+            perror("fcntl listener");
+            return false;
+        }
+        for (size_t i = 0; i < batch; ++i)
+        {
+            size_t slot = _listeners.size() * batch + i;
+            _accepts[slot].listener = fd;
+            armAccept(slot);
+        }
+        _listeners.push_back(fd);
+    }
+
+    for (int fd : udp_sockets)
+    {
+        armUdpPoll(fd);
+    }
+    armWakePoll();
+    if (_signal_fd >= 0)
+    {
+        armSignalPoll();
+    }
+    return true;
+}
+
+void UringBackend::stopListening()
+{
+    // The ring holds its own reference to each listener until the cancel completes.
+    for (size_t slot = 0; slot < _accepts.size(); ++slot)
+    {
+        if (_accepts[slot].armed)
+        {
+            cancel(tag(OP_ACCEPT, slot));
+        }
+    }
+    _listeners.clear();
+}
+
+io_uring_sqe* UringBackend::nextSqe()
+{
+    // Ring full: hand the batch to the kernel before queueing more.
+    if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries)
+    {
+        enter(0, 0, 0);
+    }
+
+    io_uring_sqe* sqe = &_sqes[_sq_local_tail & _sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++_sq_local_tail;
+    return sqe;
+}
+
+bool UringBackend::enter(unsigned min_complete, unsigned flags, int timeout_ms)
+{
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+
+    __kernel_timespec ts{};
+    io_uring_getevents_arg arg{};
+    if (timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+
+    int ret = ioUringEnter(_ring_fd, to_submit, min_complete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+    {
+        LOG_ERROR("io_uring_enter: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool UringBackend::wait(int timeout_ms)
+{
+    // Completions already queued need no sleep, only the submission.
+    if (ready() || timeout_ms == 0)
+        return enter(0, IORING_ENTER_GETEVENTS, 0);
+
+    return enter(1, IORING_ENTER_GETEVENTS, timeout_ms);
+}
+
+size_t UringBackend::dispatch()
+{
+    unsigned head = *_cq_head;
+    unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    size_t events = tail - head;
+
+    while (head != tail)
+    {
+        io_uring_cqe cqe = _cqes[head & _cq_mask];
+        __atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+
+        switch (static_cast<Op>(cqe.user_data >> 56))
+        {
+            case OP_ACCEPT:
+                handleAccept(cqe);
+                break;
+            case OP_UDP_POLL:
+                if (cqe.res > 0)
+                {
+                    _reactor.handleUdpData(static_cast<int>(cqe.user_data & TOKEN_MASK));
+                }
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                {
+                    armUdpPoll(static_cast<int>(cqe.user_data & TOKEN_MASK));
+                }
+                break;
+            case OP_WAKE_POLL:
+                if (cqe.res > 0)
+                {
+                    _reactor.handleWakeup();
+                }
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                {
+                    armWakePoll();
+                }
+                break;
+            case OP_SIGNAL_POLL:
+                if (cqe.res > 0)
+                {
+                    _reactor.handleSignal();
+                }
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                {
+                    armSignalPoll();
+                }
+                break;
+            case OP_RECV:
+                handleRecv(cqe);
+                break;
+            case OP_SEND:
+                handleSend(cqe);
+                break;
+            case OP_CANCEL:
+                break;
+        }
+    }
+
+    return events;
+}
+
+void UringBackend::armAccept(size_t slot)
+{
+    AcceptSlot& accept = _accepts[slot];
+    accept.addr_len = sizeof(accept.addr);
+    accept.armed = true;
+
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = accept.listener;
+    sqe->addr = reinterpret_cast<uint64_t>(&accept.addr);
+    sqe->addr2 = reinterpret_cast<uint64_t>(&accept.addr_len);
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = tag(OP_ACCEPT, slot);
+}
+
+void UringBackend::armUdpPoll(int fd)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag(OP_UDP_POLL, static_cast<uint64_t>(fd));
+}
+
+void UringBackend::armWakePoll()
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _wake_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag(OP_WAKE_POLL, 0);
+}
+
+void UringBackend::armSignalPoll()
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _signal_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag(OP_SIGNAL_POLL, 0);
+}
+
+void UringBackend::armRecv(ClientInfo& client)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client.fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->ioprio = _multishot_recv ? IORING_RECV_MULTISHOT : 0;
+    sqe->user_data = tag(OP_RECV, client.token());
+
+    Connection& conn = connection(client);
+    conn.recv_active = true;
+    conn.recv_starved = false;
+}
+
+void UringBackend::submitSend(ClientInfo& client, Outgoing& out)
+{
+    out.msg = msghdr{};
+    out.msg.msg_iov = out.iov.data();
+    out.msg.msg_iovlen = out.data.gather(out.iov.data(), out.iov.size());
+
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = client.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&out.msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = tag(OP_SEND, client.token());
+
+    connection(client).send_active = true;
+    client.want_write = true;
+}
+
+void UringBackend::cancel(uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = tag(OP_CANCEL, 0);
+}
+
+UringBackend::Connection& UringBackend::connection(const ClientInfo& client)
+{
+    if (client.slot >= _connections.size())
+    {
+        _connections.resize(static_cast<size_t>(client.slot) + 1);
+    }
+    return _connections[client.slot];
+}
+
+void UringBackend::recycleBuffer(uint16_t bid)
+{
+    // Not _buf_ring->bufs: in C++ the header's flexible-array wrapper shifts it by 8 bytes.
+    io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(_buf_ring)[_buf_tail & (BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(bufferData(bid));
+    buf.len = BUFFER_SIZE;
+    buf.bid = bid;
+    ++_buf_tail;
+    __atomic_store_n(&_buf_ring->tail, _buf_tail, __ATOMIC_RELEASE);
+
+    while (!_starved.empty())
+    {
+        ClientInfo* client = _reactor.resolve(_starved.front());
+        _starved.pop_front();
+        if (!client || !connection(*client).recv_starved)
+            continue;   // closed, or re-armed meanwhile
+
+        connection(*client).recv_starved = false;
+        // A paused client is re-armed by resumeRead().
+        if (!client->read_paused)
+        {
+            armRecv(*client);
+            break;
+        }
+    }
+}
+
+bool UringBackend::addClient(ClientInfo& client)
+{
+    Connection& conn = connection(client);
+    conn = Connection{};
+    conn.sending = std::make_unique<Outgoing>();
+    armRecv(client);
+    return true;
+}
+
+void UringBackend::removeClient(ClientInfo& client)
+{
+    Connection& conn = connection(client);
+
+    // The reactor closes the fd next, and requests resolve it only when submitted: a last
+    // reply still queued here would be lost.
+    if (_sq_local_tail != *_sq_tail)
+    {
+        enter(0, 0, 0);
+    }
+
+    // Cancellation is keyed by token, so it cannot hit a later connection in the same slot.
+    if (conn.recv_active)
+    {
+        cancel(tag(OP_RECV, client.token()));
+    }
+    if (conn.send_active)
+    {
+        cancel(tag(OP_SEND, client.token()));
+        _orphans.emplace_back(tag(OP_SEND, client.token()), std::move(conn.sending));
+    }
+    for (const Parked& parked : conn.parked)
+    {
+        recycleBuffer(parked.bid);
+    }
+
+    conn = Connection{};
+}
+
+void UringBackend::resumeRead(ClientInfo& client)
+{
+    Connection& conn = connection(client);
+
+    while (!conn.parked.empty() && client.active && !client.read_paused)
+    {
+        Parked parked = conn.parked.front();
+        conn.parked.pop_front();
+
+        size_t taken = deliver(client, bufferData(parked.bid) + parked.offset, parked.length);
+        if (client.active && taken < parked.length)
+        {
+            parked.offset += static_cast<uint32_t>(taken);
+            parked.length -= static_cast<uint32_t>(taken);
+            conn.parked.push_front(parked);
+        }
+        else
+        {
+            recycleBuffer(parked.bid);
+        }
+    }
+
+    if (client.active && !client.read_paused && !conn.recv_active)
+    {
+        armRecv(client);
+    }
+}
+
+size_t UringBackend::pendingOutput(const ClientInfo& client) const
+{
+    size_t pending = client.output.size();
+    if (client.slot < _connections.size())
+    {
+        const Connection& conn = _connections[client.slot];
+        if (conn.sending)
+        {
+            pending += conn.sending->data.size();
+        }
+    }
+    return pending;
+}
+
+void UringBackend::flush(ClientInfo& client)
+{
+    Connection& conn = connection(client);
+    if (conn.send_active)
+        return;
+
+    if (conn.sending->data.empty())
+    {
+        if (client.output.empty())
+            return;
+        client.output.takeInto(conn.sending->data);
+    }
+
+    submitSend(client, *conn.sending);
+}
+
+size_t UringBackend::deliver(ClientInfo& client, const char* data, size_t length)
+{
+    size_t taken = 0;
+    while (taken < length && client.active && !client.read_paused)
+    {
+        size_t space = 0;
+        char* buffer = _reactor.receiveBuffer(client, space);
+        if (!buffer)
+            break;
+
+        size_t n = std::min(space, length - taken);
+        std::memcpy(buffer, data + taken, n);
+        taken += n;
+        _reactor.onReceived(client, n);
+    }
+    return taken;
+}
+
+void UringBackend::handleAccept(const io_uring_cqe& cqe)
+{
+    size_t slot = static_cast<size_t>(cqe.user_data & TOKEN_MASK);
+    AcceptSlot& accept = _accepts[slot];
+    accept.armed = false;
+
+    if (cqe.res >= 0)
+    {
+        _reactor.acceptClient(cqe.res, accept.addr, accept.addr_len);
+    }
+    else if (cqe.res == -EMFILE || cqe.res == -ENFILE || cqe.res == -ENOBUFS || cqe.res == -ENOMEM)
+    {
+        // Retrying at once would spin; wait for connections to close.
+        if (_accepts_waiting++ == 0)
+        {
+            LOG_WARN("accept: %s", strerror(-cqe.res));
+        }
+        _reactor.timers().schedule(ACCEPT_RETRY_MS, [this, slot]()
+        {
+            --_accepts_waiting;
+            if (!_listeners.empty())    // unless listening stopped meanwhile
+            {
+                armAccept(slot);
+            }
+        });
+        return;
+    }
+    else if (cqe.res != -ECANCELED && cqe.res != -ECONNABORTED && cqe.res != -EINTR)
+    {
+        LOG_ERROR("accept: %s", strerror(-cqe.res));
+    }
+
+    if (!_listeners.empty())
+    {
+        armAccept(slot);
+    }
+}
+
+void UringBackend::handleRecv(const io_uring_cqe& cqe)
+{
+    bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+    uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+    // Completions for a connection closed earlier carry a stale generation.
+    ClientInfo* client = _reactor.resolve(cqe.user_data & TOKEN_MASK);
+    if (!client)
+    {
+        if (has_buffer)
+        {
+            recycleBuffer(bid);
+        }
+        return;
+    }
+
+    Connection& conn = connection(*client);
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+        conn.recv_active = false;
+    }
+
+    if (cqe.res > 0 && has_buffer)
+    {
+        size_t length = static_cast<size_t>(cqe.res);
+        size_t taken = 0;
+        if (!client->read_paused && conn.parked.empty())
+        {
+            taken = deliver(*client, bufferData(bid), length);
+        }
+
+        if (client->active && taken < length)
+        {
+            conn.parked.push_back(Parked{ bid, static_cast<uint32_t>(taken), static_cast<uint32_t>(length - taken) });
+        }
+        else
+        {
+            recycleBuffer(bid);
+        }
+    }
+    else if (cqe.res == 0)
+    {
+        _reactor.removeClient(*client);
+        return;
+    }
+    else if (cqe.res == -ECANCELED)
+    {
+        conn.recv_cancelling = false;
+    }
+    else if (cqe.res == -EINVAL && _multishot_recv)
+    {
+        // Before 6.0 the kernel rejects the multishot flag: recv once per submission.
+        LOG_WARN("io_uring: no multishot recv on this kernel, re-arming recv after each completion");
+        _multishot_recv = false;
+    }
+    else if (cqe.res == -ENOBUFS)
+    {
+        // Every buffer is taken, perhaps parked by paused clients: wait for one to come back.
+        if (!conn.recv_active && !conn.recv_starved)
+        {
+            conn.recv_starved = true;
+            _starved.push_back(client->token());
+        }
+    }
+    else
+    {
+        // A kernel TLS record other than application data: the peer's close_notify.
+        if (cqe.res != -EIO || !client->ktls)
+        {
+            LOG_ERROR("recv: %s", strerror(-cqe.res));
+        }
+        _reactor.removeClient(*client);
+        return;
+    }
+
+    if (!client->active)
+        return;
+
+    if (client->read_paused)
+    {
+        // Stop the kernel from filling more buffers until the backlog drains.
+        if (conn.recv_active && !conn.recv_cancelling)
+        {
+            cancel(tag(OP_RECV, client->token()));
+            conn.recv_cancelling = true;
+        }
+    }
+    else if (!conn.recv_active && !conn.recv_starved)
+    {
+        // Terminated: a cancellation that is no longer wanted, or a full CQ ring.
+        armRecv(*client);
+    }
+}
+
+void UringBackend::handleSend(const io_uring_cqe& cqe)
+{
+    ClientInfo* client = _reactor.resolve(cqe.user_data & TOKEN_MASK);
+    if (!client)
+    {
+        auto orphan = std::find_if(_orphans.begin(), _orphans.end(),
+                                   [&](const auto& entry) { return entry.first == cqe.user_data; });
+        if (orphan != _orphans.end())
+        {
+            _orphans.erase(orphan);
+        }
+        return;
+    }
+
+    Connection& conn = connection(*client);
+    conn.send_active = false;
+
+    if (cqe.res <= 0)
+    {
+        LOG_ERROR("send: %s", cqe.res < 0 ? strerror(-cqe.res) : "connection closed");
+        client->write_failed = true;
+        _reactor.onWritable(*client);
+        return;
+    }
+
+    OutputBuffer& sending = conn.sending->data;
+    sending.consume(static_cast<size_t>(cqe.res));
+    _reactor.onSent(*client, static_cast<size_t>(cqe.res));
+
+    if (sending.empty() && !client->output.empty())
+    {
+        client->output.takeInto(sending);
+    }
+
+    if (sending.empty())
+    {
+        client->want_write = false;
+    }
+    else
+    {
+        submitSend(*client, *conn.sending);
+    }
+
+    _reactor.onWritable(*client);
+}
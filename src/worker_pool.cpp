@@ -0,0 +1,90 @@
+#include "../include/worker_pool.hpp"
+
+WorkerPool::WorkerPool(size_t threads)
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (size_t i = 0; i < threads; ++i)
+    {
+        _threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _stopping = true;
+    }
+    _wakeup.notify_all();
+
+    for (auto& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(Task task)
+{
+    Queue& queue = *_queues[_next.fetch_add(1, std::memory_order_relaxed) % _queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    _queued.fetch_add(1);
+
+    // Taking the lock orders the count against a worker that is about to sleep.
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+    }
+    _wakeup.notify_one();
+}
+
+bool WorkerPool::take(size_t self, Task& task)
+{
+    for (size_t i = 0; i < _queues.size(); ++i)
+    {
+        Queue& queue = *_queues[(self + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        // Own work in submission order; stolen work from the far end.
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        _queued.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+void WorkerPool::run(size_t self)
+{
+    Task task;
+    while (true)
+    {
+        if (take(self, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _wakeup.wait(lock, [this]() { return _queued.load() > 0 || _stopping; });
+        if (_stopping && _queued.load() == 0)
+            return;
+    }
+}
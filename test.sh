@@ -2,21 +2,53 @@
 set -e
 
 # Собираем всё
-make test
+make test bench
 
-# Запускаем сервер в фоне
-./bin/cpp-network-server &
+# Запускаем сервер в фоне; короткий --idle-timeout проверяет, что тихих подписчиков
+# он не закрывает
+./bin/cpp-network-server --idle-timeout 2 &
 SERVER_PID=$!
 
 # Небольшая пауза, чтобы сервер поднялся
 sleep 1
 
 # Запускаем тестовый клиент
-./bin/test-server
-STATUS=$?
+STATUS=0
+./bin/test-server || STATUS=$?
+
+# Короткий прогон нагрузки вместо старого стресс-теста
+./bin/bench --connections 100 --pipeline 4 --mix echo=8,time=1,stats=1 --duration 2 --warmup 0.5 || STATUS=$?
 
 # Гасим сервер
 kill "$SERVER_PID" || true
 wait "$SERVER_PID" 2>/dev/null || true
 
+# Эхо через TLS: только для сборки make TLS=1 на ядре с модулем tls, иначе сервер с
+# --tls-port не стартует и шаг пропускается. Длинная строка проверяет, что --zerocopy
+# не применяется к сокетам с kTLS.
+TLS_DIR=$(mktemp -d)
+openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+    -keyout "$TLS_DIR/key.pem" -out "$TLS_DIR/cert.pem" -days 1 -subj /CN=localhost 2>/dev/null
+./bin/cpp-network-server --tcp-port 18080 --udp-port 18081 --zerocopy 4096 --tls-port 18443 \
+    --tls-cert "$TLS_DIR/cert.pem" --tls-key "$TLS_DIR/key.pem" >/dev/null 2>&1 &
+TLS_PID=$!
+sleep 1
+if kill -0 "$TLS_PID" 2>/dev/null; then
+    LONG_LINE=$(head -c 8192 /dev/zero | tr '\0' x)
+    EXPECTED=$(printf 'Hello over TLS\n%s' "$LONG_LINE")
+    REPLY=$( (printf 'Hello over TLS\n%s\n' "$LONG_LINE"; sleep 1) \
+        | timeout 5 openssl s_client -quiet -connect 127.0.0.1:18443 2>/dev/null || true)
+    if [ "$REPLY" = "$EXPECTED" ]; then
+        echo "TLS echo: OK"
+    else
+        echo "TLS echo: FAILED"
+        STATUS=1
+    fi
+    kill "$TLS_PID" || true
+    wait "$TLS_PID" 2>/dev/null || true
+else
+    echo "TLS echo: skipped (no make TLS=1 build or no kernel TLS)"
+fi
+rm -rf "$TLS_DIR"
+
 exit "$STATUS"
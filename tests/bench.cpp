@@ -0,0 +1,807 @@
+// Load generator for cpp-network-server.
+//
+// Every worker thread drives its share of the connections from its own epoll loop.
+// Closed-loop mode keeps `--pipeline` requests in flight per connection; open-loop mode
+// (`--rate`) sends on a fixed schedule regardless of replies and measures latency from
+// the intended send time, so a stalled server is not hidden by a stalled client.
+// Results are printed as one JSON object.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <deque>
+#include <vector>
+#include <array>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static uint64_t nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Log-linear latency histogram in the style of HdrHistogram: each power of two is split
+// into 64 linear sub-buckets, so any recorded value is reported within ~1.6%.
+class LatencyHistogram
+{
+public:
+    void record(uint64_t value_ns)
+    {
+        value_ns = std::min(value_ns, MAX_VALUE);
+        ++_counts[indexOf(value_ns)];
+        ++_count;
+        _sum += value_ns;
+        _min = std::min(_min, value_ns);
+        _max = std::max(_max, value_ns);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            _counts[i] += other._counts[i];
+        }
+        _count += other._count;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    // Smallest recorded value such that `percentile` percent of all values are <= it.
+    uint64_t percentile(double percentile) const
+    {
+        if (_count == 0)
+            return 0;
+
+        uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(_count)));
+        target = std::max<uint64_t>(target, 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += _counts[i];
+            if (seen >= target)
+                return std::min(highestEquivalent(i), _max);
+        }
+        return _max;
+    }
+
+    uint64_t count() const { return _count; }
+    uint64_t min() const { return _count ? _min : 0; }
+    uint64_t max() const { return _max; }
+    double mean() const { return _count ? static_cast<double>(_sum) / static_cast<double>(_count) : 0.0; }
+
+private:
+    static constexpr int SUB_BITS = 6;
+    static constexpr uint64_t SUB_COUNT = 1ull << SUB_BITS;     // sub-buckets per power of two
+    static constexpr uint64_t MAX_VALUE = (1ull << 40) - 1;     // ~18 minutes in ns
+    static constexpr size_t BUCKETS = (40 - SUB_BITS + 1) * SUB_COUNT + SUB_COUNT;
+
+    // Values below 2 * SUB_COUNT map to themselves; above that, bucket width doubles with
+    // every power of two.
+    static size_t indexOf(uint64_t value)
+    {
+        if (value < 2 * SUB_COUNT)
+            return static_cast<size_t>(value);
+
+        int shift = (63 - __builtin_clzll(value)) - SUB_BITS;
+        return static_cast<size_t>(shift) * SUB_COUNT + static_cast<size_t>(value >> shift);
+    }
+
+    static uint64_t highestEquivalent(size_t index)
+    {
+        if (index < 2 * SUB_COUNT)
+            return index;
+
+        uint64_t shift = index / SUB_COUNT - 1;
+        uint64_t sub = index - shift * SUB_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, BUCKETS> _counts{};
+    uint64_t _count = 0;
+    uint64_t _sum = 0;
+    uint64_t _min = UINT64_MAX;
+    uint64_t _max = 0;
+};
+
+enum class Command : uint8_t
+{
+    Echo,
+    Time,
+    Stats
+};
+
+struct BenchConfig
+{
+    std::string host = "127.0.0.1";
+    int port = 0;                   // 0: 8080 for TCP, 8081 for UDP
+    bool udp = false;
+    int threads = 2;
+    int connections = 64;           // total, split across threads
+    int pipeline = 1;               // requests in flight per connection (closed loop)
+    int message_size = 32;          // echo payload bytes, without the newline
+    double rate = 0.0;              // requests per second over all threads; 0 = closed loop
+    double duration_s = 10.0;
+    double warmup_s = 1.0;
+    int timeout_ms = 1000;          // UDP replies older than this count as lost
+    std::array<int, 3> mix{ { 1, 0, 0 } };  // weights of echo, /time, /stats
+    std::string output;             // JSON destination; empty = stdout
+};
+
+struct Pending
+{
+    uint64_t start_ns;
+    Command command;
+};
+
+struct Connection
+{
+    int fd = -1;
+    bool connected = false;
+    bool want_write = false;
+    std::string out;
+    size_t out_pos = 0;
+    std::deque<Pending> pending;    // requests in flight, oldest first
+    size_t line_pos = 0;            // bytes received of the current reply line
+    char line_head[8] = {};         // its first bytes, to spot the end of a /stats reply
+};
+
+struct WorkerResult
+{
+    LatencyHistogram latency;
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    uint64_t connect_errors = 0;
+    uint64_t errors = 0;            // connections dropped mid-run, failed sends
+    uint64_t timeouts = 0;
+};
+
+class Worker
+{
+public:
+    Worker(const BenchConfig& config, const sockaddr_in& server, int connections, int id)
+        :   _config{ config },
+            _server{ server },
+            _connections(connections),
+            _rng{ 0x9e3779b97f4a7c15ull * static_cast<uint64_t>(id + 1) }
+    {
+        _echo.assign(static_cast<size_t>(std::max(config.message_size, 1)), 'x');
+        _echo.push_back('\n');
+        _mix_total = config.mix[0] + config.mix[1] + config.mix[2];
+    }
+
+    ~Worker()
+    {
+        for (auto& conn : _connections)
+        {
+            if (conn.fd >= 0)
+                close(conn.fd);
+        }
+        if (_epoll_fd >= 0)
+            close(_epoll_fd);
+    }
+
+    void run(uint64_t start_ns, uint64_t measure_ns, uint64_t end_ns)
+    {
+        _measure_ns = measure_ns;
+
+        _epoll_fd = epoll_create1(0);
+        if (_epoll_fd < 0)
+        {
+            perror("epoll_create1");
+            return;
+        }
+
+        for (size_t i = 0; i < _connections.size(); ++i)
+        {
+            openConnection(i);
+        }
+
+        const bool open_loop = _config.rate > 0.0;
+        const uint64_t interval_ns = open_loop
+            ? static_cast<uint64_t>(1e9 * _config.threads / _config.rate)
+            : 0;
+        uint64_t next_send_ns = start_ns;
+        uint64_t next_timeout_check_ns = start_ns;
+        size_t next_conn = 0;
+
+        epoll_event events[256];
+        while (true)
+        {
+            uint64_t now = nowNs();
+            if (now >= end_ns)
+                break;
+
+            if (open_loop)
+            {
+                // Catch up on every send that came due, even if we woke up late.
+                for (size_t tries = 0; next_send_ns <= now && tries < _connections.size();)
+                {
+                    Connection& conn = _connections[next_conn];
+                    size_t index = next_conn;
+                    next_conn = (next_conn + 1) % _connections.size();
+                    if (!conn.connected)
+                    {
+                        ++tries;
+                        continue;
+                    }
+
+                    issue(index, next_send_ns);
+                    next_send_ns += interval_ns;
+                    tries = 0;
+                }
+            }
+
+            if (_config.udp && now >= next_timeout_check_ns)
+            {
+                expireUdp(now);
+                next_timeout_check_ns = now + 10000000ull;
+            }
+
+            uint64_t wake_ns = std::min(end_ns, next_timeout_check_ns);
+            if (open_loop)
+                wake_ns = std::min(wake_ns, next_send_ns);
+            int timeout_ms = wake_ns > now ? static_cast<int>((wake_ns - now) / 1000000ull) : 0;
+
+            int nfds = epoll_wait(_epoll_fd, events, 256, timeout_ms);
+            if (nfds < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait");
+                break;
+            }
+
+            for (int i = 0; i < nfds; ++i)
+            {
+                size_t index = events[i].data.u32;
+                Connection& conn = _connections[index];
+                if (conn.fd < 0)
+                    continue;
+
+                if (!conn.connected)
+                {
+                    finishConnect(index);
+                    continue;
+                }
+
+                if (events[i].events & (EPOLLHUP | EPOLLERR))
+                {
+                    drop(index);
+                    continue;
+                }
+
+                if (events[i].events & EPOLLIN)
+                    readReplies(index);
+                if (conn.fd >= 0 && (events[i].events & EPOLLOUT))
+                    flush(index);
+            }
+        }
+    }
+
+    const WorkerResult& result() const { return _result; }
+
+private:
+    void openConnection(size_t index)
+    {
+        Connection& conn = _connections[index];
+        conn.fd = socket(AF_INET, (_config.udp ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK, 0);
+        if (conn.fd < 0)
+        {
+            ++_result.connect_errors;
+            return;
+        }
+
+        if (!_config.udp)
+        {
+            int one = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        if (connect(conn.fd, (const sockaddr*)&_server, sizeof(_server)) < 0 && errno != EINPROGRESS)
+        {
+            ++_result.connect_errors;
+            close(conn.fd);
+            conn.fd = -1;
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = _config.udp ? EPOLLIN : EPOLLOUT;
+        ev.data.u32 = static_cast<uint32_t>(index);
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, conn.fd, &ev);
+
+        if (_config.udp)
+            connected(index);
+    }
+
+    void finishConnect(size_t index)
+    {
+        Connection& conn = _connections[index];
+
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0)
+        {
+            ++_result.connect_errors;
+            close(conn.fd);
+            conn.fd = -1;
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(index);
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+
+        connected(index);
+    }
+
+    void connected(size_t index)
+    {
+        _connections[index].connected = true;
+
+        if (_config.rate <= 0.0)
+        {
+            uint64_t now = nowNs();
+            for (int i = 0; i < _config.pipeline; ++i)
+            {
+                issue(index, now);
+            }
+        }
+    }
+
+    Command pickCommand()
+    {
+        // xorshift64: cheap and good enough to pick from the mix
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 7;
+        _rng ^= _rng << 17;
+
+        int roll = static_cast<int>(_rng % static_cast<uint64_t>(_mix_total));
+        if (roll < _config.mix[0])
+            return Command::Echo;
+        if (roll < _config.mix[0] + _config.mix[1])
+            return Command::Time;
+        return Command::Stats;
+    }
+
+    void issue(size_t index, uint64_t start_ns)
+    {
+        Connection& conn = _connections[index];
+        Command command = pickCommand();
+
+        const char* data = _echo.data();
+        size_t size = _echo.size();
+        if (command == Command::Time)
+        {
+            data = "/time\n";
+            size = 6;
+        }
+        else if (command == Command::Stats)
+        {
+            data = "/stats\n";
+            size = 7;
+        }
+
+        conn.pending.push_back(Pending{ start_ns, command });
+        ++_result.requests;
+
+        if (_config.udp)
+        {
+            ssize_t sent = send(conn.fd, data, size, 0);
+            if (sent < 0)
+            {
+                // Counted as a timeout once it is old enough, like any other lost datagram.
+                ++_result.errors;
+                return;
+            }
+            _result.bytes_sent += static_cast<uint64_t>(sent);
+            return;
+        }
+
+        conn.out.append(data, size);
+        if (!conn.want_write)
+            flush(index);
+    }
+
+    void flush(size_t index)
+    {
+        Connection& conn = _connections[index];
+
+        while (conn.out_pos < conn.out.size())
+        {
+            ssize_t sent = send(conn.fd, conn.out.data() + conn.out_pos, conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                drop(index);
+                return;
+            }
+            conn.out_pos += static_cast<size_t>(sent);
+            _result.bytes_sent += static_cast<uint64_t>(sent);
+        }
+
+        if (conn.out_pos == conn.out.size())
+        {
+            conn.out.clear();
+            conn.out_pos = 0;
+        }
+
+        bool want_write = !conn.out.empty();
+        if (want_write != conn.want_write)
+        {
+            conn.want_write = want_write;
+            epoll_event ev{};
+            ev.events = EPOLLIN | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            ev.data.u32 = static_cast<uint32_t>(index);
+            epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+        }
+    }
+
+    void readReplies(size_t index)
+    {
+        Connection& conn = _connections[index];
+        char buffer[65536];
+
+        while (conn.fd >= 0)
+        {
+            ssize_t bytes = recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (bytes < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    drop(index);
+                return;
+            }
+            if (bytes == 0)
+            {
+                drop(index);
+                return;
+            }
+
+            _result.bytes_received += static_cast<uint64_t>(bytes);
+            uint64_t now = nowNs();
+
+            if (_config.udp)
+            {
+                // One datagram per reply, however many lines it holds.
+                if (!conn.pending.empty())
+                    complete(index, now);
+                continue;
+            }
+
+            for (ssize_t i = 0; i < bytes; ++i)
+            {
+                char c = buffer[i];
+                if (c != '\n')
+                {
+                    if (conn.line_pos < sizeof(conn.line_head))
+                        conn.line_head[conn.line_pos] = c;
+                    ++conn.line_pos;
+                    continue;
+                }
+
+                // A /stats reply spans several lines and ends with the uptime.
+                bool last_line = conn.pending.empty() || conn.pending.front().command != Command::Stats ||
+                                 (conn.line_pos >= 7 && std::memcmp(conn.line_head, "Uptime:", 7) == 0);
+                conn.line_pos = 0;
+                if (last_line && !conn.pending.empty())
+                    complete(index, now);
+            }
+        }
+    }
+
+    void complete(size_t index, uint64_t now)
+    {
+        Connection& conn = _connections[index];
+        Pending request = conn.pending.front();
+        conn.pending.pop_front();
+
+        if (now >= _measure_ns)
+        {
+            ++_result.responses;
+            _result.latency.record(now - request.start_ns);
+        }
+
+        if (_config.rate <= 0.0)
+            issue(index, now);
+    }
+
+    void expireUdp(uint64_t now)
+    {
+        uint64_t limit_ns = static_cast<uint64_t>(_config.timeout_ms) * 1000000ull;
+        for (size_t i = 0; i < _connections.size(); ++i)
+        {
+            Connection& conn = _connections[i];
+            while (!conn.pending.empty() && now - conn.pending.front().start_ns > limit_ns)
+            {
+                conn.pending.pop_front();
+                ++_result.timeouts;
+                if (conn.connected && _config.rate <= 0.0)
+                    issue(i, now);
+            }
+        }
+    }
+
+    void drop(size_t index)
+    {
+        Connection& conn = _connections[index];
+        ++_result.errors;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conn.fd = -1;
+        conn.connected = false;
+        conn.pending.clear();
+    }
+
+private:
+    const BenchConfig& _config;
+    sockaddr_in _server;
+    std::vector<Connection> _connections;
+    std::string _echo;
+    int _mix_total = 1;
+    uint64_t _rng;
+    uint64_t _measure_ns = 0;
+    int _epoll_fd = -1;
+    WorkerResult _result;
+};
+
+static bool parseMix(const std::string& text, std::array<int, 3>& mix)
+{
+    mix = { { 0, 0, 0 } };
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        int weight = eq == std::string::npos ? 1 : std::atoi(item.c_str() + eq + 1);
+        if (weight < 0)
+            return false;
+
+        if (name == "echo") mix[0] = weight;
+        else if (name == "time") mix[1] = weight;
+        else if (name == "stats") mix[2] = weight;
+        else return false;
+    }
+    return mix[0] + mix[1] + mix[2] > 0;
+}
+
+static void printUsage(const char* program_name)
+{
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "Options:\n"
+              << "      --host ADDR        Server IPv4 address (default: 127.0.0.1)\n"
+              << "      --port PORT        Server port (default: 8080 for TCP, 8081 for UDP)\n"
+              << "      --udp              Send datagrams instead of TCP lines\n"
+              << "  -n, --threads N        Worker threads (default: 2)\n"
+              << "  -c, --connections N    Connections (UDP sockets) over all threads (default: 64)\n"
+              << "  -p, --pipeline N       Requests in flight per connection, closed loop (default: 1)\n"
+              << "  -s, --size BYTES       Echo payload size (default: 32)\n"
+              << "  -m, --mix SPEC         Command weights, e.g. echo=8,time=1,stats=1 (default: echo)\n"
+              << "  -r, --rate N           Open loop: N requests/s in total, 0 = closed loop (default: 0)\n"
+              << "  -d, --duration SEC     Measured run time (default: 10)\n"
+              << "  -w, --warmup SEC       Unmeasured run time before that (default: 1)\n"
+              << "      --timeout MS       UDP replies older than this are counted lost (default: 1000)\n"
+              << "  -o, --output FILE      Write the JSON report to FILE (default: stdout)\n"
+              << "  -h, --help             Show this help message\n";
+}
+
+static bool parseArguments(int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: " << arg << " requires an argument\n";
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        const char* v = nullptr;
+        if (arg == "-h" || arg == "--help")
+        {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        else if (arg == "--udp")
+        {
+            config.udp = true;
+            continue;
+        }
+
+        if (!(v = value()))
+            return false;
+
+        if (arg == "--host") config.host = v;
+        else if (arg == "--port") config.port = std::atoi(v);
+        else if (arg == "-n" || arg == "--threads") config.threads = std::atoi(v);
+        else if (arg == "-c" || arg == "--connections") config.connections = std::atoi(v);
+        else if (arg == "-p" || arg == "--pipeline") config.pipeline = std::atoi(v);
+        else if (arg == "-s" || arg == "--size") config.message_size = std::atoi(v);
+        else if (arg == "-r" || arg == "--rate") config.rate = std::atof(v);
+        else if (arg == "-d" || arg == "--duration") config.duration_s = std::atof(v);
+        else if (arg == "-w" || arg == "--warmup") config.warmup_s = std::atof(v);
+        else if (arg == "--timeout") config.timeout_ms = std::atoi(v);
+        else if (arg == "-o" || arg == "--output") config.output = v;
+        else if (arg == "-m" || arg == "--mix")
+        {
+            if (!parseMix(v, config.mix))
+            {
+                std::cerr << "Error: Invalid mix '" << v << "'\n";
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr << "Error: Unknown option '" << arg << "'\n";
+            return false;
+        }
+    }
+
+    if (config.port == 0)
+        config.port = config.udp ? 8081 : 8080;
+
+    if (config.threads < 1 || config.connections < config.threads || config.pipeline < 1 ||
+        config.message_size < 1 || config.duration_s <= 0.0 || config.warmup_s < 0.0 || config.rate < 0.0)
+    {
+        std::cerr << "Error: Invalid load parameters\n";
+        return false;
+    }
+
+    return true;
+}
+
+static void raiseFileLimit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static std::string toJson(const BenchConfig& config, const WorkerResult& total, double elapsed_s)
+{
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    const LatencyHistogram& h = total.latency;
+
+    std::stringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(3);
+    ss << "{\n"
+       << "  \"protocol\": \"" << (config.udp ? "udp" : "tcp") << "\",\n"
+       << "  \"mode\": \"" << (config.rate > 0.0 ? "open" : "closed") << "\",\n"
+       << "  \"threads\": " << config.threads << ",\n"
+       << "  \"connections\": " << config.connections << ",\n"
+       << "  \"pipeline\": " << config.pipeline << ",\n"
+       << "  \"message_size\": " << config.message_size << ",\n"
+       << "  \"target_rate\": " << config.rate << ",\n"
+       << "  \"mix\": { \"echo\": " << config.mix[0] << ", \"time\": " << config.mix[1]
+       << ", \"stats\": " << config.mix[2] << " },\n"
+       << "  \"duration_s\": " << elapsed_s << ",\n"
+       << "  \"requests\": " << total.requests << ",\n"
+       << "  \"responses\": " << total.responses << ",\n"
+       << "  \"throughput_rps\": " << (elapsed_s > 0.0 ? static_cast<double>(total.responses) / elapsed_s : 0.0) << ",\n"
+       << "  \"bytes_sent\": " << total.bytes_sent << ",\n"
+       << "  \"bytes_received\": " << total.bytes_received << ",\n"
+       << "  \"connect_errors\": " << total.connect_errors << ",\n"
+       << "  \"errors\": " << total.errors << ",\n"
+       << "  \"timeouts\": " << total.timeouts << ",\n"
+       << "  \"latency_us\": {\n"
+       << "    \"min\": " << us(h.min()) << ",\n"
+       << "    \"mean\": " << h.mean() / 1000.0 << ",\n"
+       << "    \"p50\": " << us(h.percentile(50.0)) << ",\n"
+       << "    \"p90\": " << us(h.percentile(90.0)) << ",\n"
+       << "    \"p99\": " << us(h.percentile(99.0)) << ",\n"
+       << "    \"p999\": " << us(h.percentile(99.9)) << ",\n"
+       << "    \"max\": " << us(h.max()) << "\n"
+       << "  }\n"
+       << "}\n";
+    return ss.str();
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    if (!parseArguments(argc, argv, config))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(static_cast<uint16_t>(config.port));
+    if (inet_pton(AF_INET, config.host.c_str(), &server.sin_addr) != 1)
+    {
+        std::cerr << "Error: Invalid host '" << config.host << "'\n";
+        return 1;
+    }
+
+    raiseFileLimit();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < config.threads; ++i)
+    {
+        int share = config.connections / config.threads + (i < config.connections % config.threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(config, server, share, i));
+    }
+
+    uint64_t start_ns = nowNs();
+    uint64_t measure_ns = start_ns + static_cast<uint64_t>(config.warmup_s * 1e9);
+    uint64_t end_ns = measure_ns + static_cast<uint64_t>(config.duration_s * 1e9);
+
+    std::vector<std::thread> threads;
+    for (auto& worker : workers)
+    {
+        threads.emplace_back([&worker, start_ns, measure_ns, end_ns]() { worker->run(start_ns, measure_ns, end_ns); });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    WorkerResult total;
+    for (const auto& worker : workers)
+    {
+        const WorkerResult& r = worker->result();
+        total.latency.merge(r.latency);
+        total.requests += r.requests;
+        total.responses += r.responses;
+        total.bytes_sent += r.bytes_sent;
+        total.bytes_received += r.bytes_received;
+        total.connect_errors += r.connect_errors;
+        total.errors += r.errors;
+        total.timeouts += r.timeouts;
+    }
+
+    std::string report = toJson(config, total, static_cast<double>(end_ns - measure_ns) / 1e9);
+    if (config.output.empty())
+    {
+        std::cout << report;
+    }
+    else
+    {
+        std::ofstream file(config.output);
+        file << report;
+        if (!file)
+        {
+            std::cerr << "Error: Cannot write " << config.output << "\n";
+            return 1;
+        }
+    }
+
+    return total.responses > 0 ? 0 : 1;
+}
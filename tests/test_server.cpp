@@ -4,7 +4,10 @@
 #include <thread>
 #include <chrono>
 #include <vector>
+#include <algorithm>
+#include <csignal>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -17,7 +20,8 @@ public:
     {
     }
 
-    void runTests() 
+    // Returns false if any check failed.
+    bool runTests() 
     {
         std::cout << "\n=== Network Server Test Client ===\n\n";
         
@@ -28,13 +32,21 @@ public:
         
         std::cout << "\n2. Testing UDP connection...\n";
         testUdp();
+
+        std::cout << "\n3. Testing binary framing...\n";
+        testBinary();
+
+        std::cout << "\n4. Testing offloaded commands...\n";
+        testOffload();
+
+        std::cout << "\n5. Testing the key-value store...\n";
+        testKv();
+
+        std::cout << "\n6. Testing pub/sub...\n";
+        testPubSub();
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        std::cout << "\n3. Running stress test...\n";
-        stressTest();
-        
-        std::cout << "\n=== All tests completed ===\n";
+        std::cout << "\n=== All tests completed" << (failures_ > 0 ? " with failures" : "") << " ===\n";
+        return failures_ == 0;
     }
 
 private:
@@ -69,10 +81,117 @@ private:
         
         sendAndReceive(sock, "/unknown", "\tTesting unknown cmd: ");
 
+        testPartialLine(sock);
+
         close(sock);
         std::cout << "\tTCP tests completed\n";
     }
 
+    void testPartialLine(int sock)
+    {
+        // One line split across several writes must come back as a single message.
+        const char* parts[] = { "Split ", "across ", "writes\nsecond", " line\n" };
+        for (const char* part : parts)
+        {
+            send(sock, part, strlen(part), 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        std::string expected = "Split across writes\nsecond line\n";
+        std::string received;
+        char buffer[1024];
+        while (received.size() < expected.size())
+        {
+            int bytes = recv(sock, buffer, sizeof(buffer), 0);
+            if (bytes <= 0) break;
+            received.append(buffer, bytes);
+        }
+
+        check("partial lines", received == expected);
+    }
+
+    void testOffload()
+    {
+        int sock = connectTcp();
+        if (sock < 0)
+            return;
+
+        // /sleep runs on the worker pool; the echo sent right behind it must still be
+        // answered second.
+        std::string request = "/sleep 200\nAfter the sleep\n";
+        send(sock, request.data(), request.size(), 0);
+        std::string first = readLine(sock);
+        std::string second = readLine(sock);
+        std::cout << "\t'/sleep 200' -> '" << first << "', then '" << second << "'\n";
+        check("reply order behind an offloaded command", first == "Slept 200 ms" && second == "After the sleep");
+
+        close(sock);
+        std::cout << "\tOffload tests completed\n";
+    }
+
+    void testKv()
+    {
+        int sock = connectTcp();
+        if (sock < 0)
+            return;
+
+        request(sock, "/del test:str test:num test:ttl");
+        check("set", request(sock, "/set test:str hello world") == "OK");
+        check("get", request(sock, "/get test:str") == "hello world");
+        check("get of a missing key", request(sock, "/get test:missing") == "(nil)");
+        check("incr of a non-integer", request(sock, "/incr test:str") == "Error: value is not an integer");
+
+        request(sock, "/set test:num 9223372036854775806");
+        check("incr", request(sock, "/incr test:num") == "9223372036854775807");
+        check("incr overflow", request(sock, "/incr test:num") == "Error: increment would overflow");
+        check("del", request(sock, "/del test:str test:num test:missing") == "2");
+
+        request(sock, "/set test:ttl soon gone");
+        check("expire", request(sock, "/expire test:ttl 1") == "1");
+        check("get before the TTL", request(sock, "/get test:ttl") == "soon gone");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        check("get after the TTL", request(sock, "/get test:ttl") == "(nil)");
+
+        close(sock);
+        std::cout << "\tKey-value tests completed\n";
+    }
+
+    void testPubSub()
+    {
+        int subscriber = connectTcp();
+        int publisher = connectTcp();
+        if (subscriber < 0 || publisher < 0)
+        {
+            if (subscriber >= 0) close(subscriber);
+            if (publisher >= 0) close(publisher);
+            return;
+        }
+
+        check("subscribe", request(subscriber, "/subscribe test:news") == "Subscribed to test:news");
+        check("publish", request(publisher, "/publish test:news hello subscribers") == "Published to test:news");
+        std::string message = readLine(subscriber);
+        std::cout << "\tSubscriber got: '" << message << "'\n";
+        check("delivery", message == "message test:news hello subscribers");
+
+        // test.sh runs the server with --idle-timeout 2; a quiet subscriber must outlive it.
+        close(publisher);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        publisher = connectTcp();
+        request(publisher, "/publish test:news after a quiet while");
+        check("subscriber kept past the idle timeout",
+              readLine(subscriber) == "message test:news after a quiet while");
+
+        check("unsubscribe", request(subscriber, "/unsubscribe test:news") == "Unsubscribed from test:news");
+        request(publisher, "/publish test:news nobody listens");
+        // Delivery may cross reactors; give it a moment, then the echo must be next.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        check("no delivery after unsubscribe", request(subscriber, "still here") == "still here");
+
+        close(subscriber);
+        close(publisher);
+        std::cout << "\tPub/sub tests completed\n";
+    }
+
     void testUdp() 
     {
         int sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -99,65 +218,141 @@ private:
         std::cout << "\tUDP tests completed\n";
     }
 
-    void stressTest() 
+    static std::string frame(uint32_t request_id, uint8_t opcode, const std::string& payload)
     {
-        std::cout << "\tStarting stress test with 5 concurrent connections...\n";
-        
-        std::vector<std::thread> threads;
-        
-        for (int i = 0; i < 5; ++i) 
+        // length, request id, opcode, status; see include/frame.hpp
+        uint32_t length = htonl(static_cast<uint32_t>(payload.size()));
+        uint32_t id = htonl(request_id);
+        std::string out(reinterpret_cast<const char*>(&length), 4);
+        out.append(reinterpret_cast<const char*>(&id), 4);
+        out.push_back(static_cast<char>(opcode));
+        out.push_back('\0');
+        return out + payload;
+    }
+
+    static bool recvAll(int sock, char* buffer, size_t size)
+    {
+        size_t received = 0;
+        while (received < size)
         {
-            threads.emplace_back([this, i]() 
-            {
-                int sock = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock < 0) return;
-
-                struct sockaddr_in server_addr{};
-                server_addr.sin_family = AF_INET;
-                server_addr.sin_port = htons(tcp_port_);
-                inet_pton(AF_INET, server_ip_.c_str(), &server_addr.sin_addr);
-
-                if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) 
-                {
-                    close(sock);
-                    return;
-                }
-
-                for (int j = 0; j < 10; ++j) 
-                {
-                    std::string msg = "Client " + std::to_string(i) + " message " + std::to_string(j) + "\n";
-                    send(sock, msg.c_str(), msg.length(), 0);
-                    
-                    char buffer[1024];
-                    recv(sock, buffer, sizeof(buffer), 0);
-                    
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
-
-                std::string cmd = "/stats\n";
-                send(sock, cmd.c_str(), cmd.length(), 0);
-                
-                char buffer[1024];
-                int bytes = recv(sock, buffer, sizeof(buffer) - 1, 0);
-                if (bytes > 0) 
-                {
-                    buffer[bytes] = '\0';
-                    if (i == 0) 
-                    {
-                        std::cout << "\tCurrent stats:\n" << buffer;
-                    }
-                }
-
-                close(sock);
-            });
+            int bytes = recv(sock, buffer + received, size - received, 0);
+            if (bytes <= 0) return false;
+            received += bytes;
+        }
+        return true;
+    }
+
+    struct Frame
+    {
+        uint32_t id = 0;
+        int opcode = -1;
+        int status = -1;
+        std::string payload;
+    };
+
+    void testBinary()
+    {
+        int sock = connectTcp();
+        if (sock < 0)
+            return;
+
+        // Magic byte, then an echo with a newline inside and /time by its opcode (0x10).
+        std::string request = "\xB1" + frame(7, 0x00, "binary\npayload") + frame(8, 0x10, "");
+        send(sock, request.data(), request.size(), 0);
+
+        Frame echo = readFrame(sock);
+        Frame time = readFrame(sock);
+        std::cout << "\tFrame " << echo.id << ": '" << echo.payload << "', frame " << time.id
+                  << ": '" << time.payload << "'\n";
+        check("binary echo", echo.id == 7 && echo.opcode == 0x00 && echo.status == 0 &&
+                             echo.payload == "binary\npayload");
+        check("binary /time by opcode", time.id == 8 && time.opcode == 0x10 && time.status == 0 &&
+                                        !time.payload.empty());
+
+        close(sock);
+        std::cout << "\tBinary tests completed\n";
+    }
+
+    // The next reply frame; opcode and status stay -1 if none arrives in time.
+    static Frame readFrame(int sock)
+    {
+        Frame result;
+        char header[10];
+        if (!recvAll(sock, header, sizeof(header)))
+            return result;
+
+        uint32_t length, id;
+        memcpy(&length, header, 4);
+        memcpy(&id, header + 4, 4);
+        std::string payload(std::min<uint32_t>(ntohl(length), 65536), '\0');
+        if (!recvAll(sock, &payload[0], payload.size()))
+            return result;
+
+        result.id = ntohl(id);
+        result.opcode = static_cast<unsigned char>(header[8]);
+        result.status = static_cast<unsigned char>(header[9]);
+        result.payload = std::move(payload);
+        return result;
+    }
+
+    void check(const std::string& what, bool ok)
+    {
+        std::cout << "\tTesting " << what << ": " << (ok ? "OK" : "FAILED") << "\n";
+        if (!ok)
+        {
+            ++failures_;
+        }
+    }
+
+    // A connected TCP socket whose reads give up after two seconds, or -1.
+    int connectTcp()
+    {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0)
+        {
+            std::cerr << "\tFailed to create TCP socket\n";
+            ++failures_;
+            return -1;
+        }
+
+        sockaddr_in server_addr{};
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(tcp_port_);
+        inet_pton(AF_INET, server_ip_.c_str(), &server_addr.sin_addr);
+
+        if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+        {
+            std::cerr << "\tFailed to connect to TCP server\n";
+            ++failures_;
+            close(sock);
+            return -1;
         }
 
-        for (auto& t : threads) 
+        timeval timeout{ 2, 0 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        return sock;
+    }
+
+    // One reply line without its newline; empty if none arrived in time.
+    static std::string readLine(int sock)
+    {
+        std::string line;
+        char c;
+        while (recv(sock, &c, 1, 0) == 1)
         {
-            t.join();
+            if (c == '\n')
+                return line;
+            line.push_back(c);
         }
+        return std::string();
+    }
 
-        std::cout << "\tStress test completed\n";
+    // Sends `message` as a line and returns the reply line.
+    static std::string request(int sock, const std::string& message)
+    {
+        std::string msg = message + "\n";
+        send(sock, msg.c_str(), msg.length(), 0);
+        return readLine(sock);
     }
 
     void sendAndReceive(int sock, const std::string& message, const std::string& prefix) 
@@ -208,6 +403,7 @@ private:
     std::string server_ip_;
     int tcp_port_;
     int udp_port_;
+    int failures_ = 0;
 };
 
 int main(int argc, char* argv[]) 
@@ -220,11 +416,12 @@ int main(int argc, char* argv[])
     if (argc > 2) tcp_port = std::atoi(argv[2]);
     if (argc > 3) udp_port = std::atoi(argv[3]);
 
+    // A connection the server closed must fail its check, not kill the client.
+    signal(SIGPIPE, SIG_IGN);
+
     std::cout << "Connecting to server at " << server_ip 
               << " (TCP:" << tcp_port << ", UDP:" << udp_port << ")\n";
 
     TestClient client(server_ip, tcp_port, udp_port);
-    client.runTests();
-
-    return 0;
+    return client.runTests() ? 0 : 1;
 }